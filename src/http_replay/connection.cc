@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "connection.h"
+
+namespace packet_replay {
+    static std::string sslError(SSL* ssl, int ret) {
+        auto err = SSL_get_error(ssl, ret);
+
+        if (err == SSL_ERROR_SYSCALL && errno != 0) {
+            return std::string(strerror(errno)) + " (" + std::to_string(errno) + ")";
+        }
+
+        char buf[256];
+        ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+
+        return std::string(buf) + " (" + std::to_string(err) + ")";
+    }
+
+    Connection::~Connection() {
+        if (ssl_ != nullptr) {
+            if (shutdown_) {
+                SSL_shutdown(ssl_);
+            }
+
+            SSL_free(ssl_);
+        }
+
+        close(socket_);
+    }
+
+    int Connection::read(uint8_t* buf, int buf_len) {
+        if (ssl_ == nullptr) {
+            auto n = ::read(socket_, buf, buf_len);
+
+            if (n < 0) {
+                shutdown_ = false;
+                throw std::runtime_error("read failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+            }
+
+            return n;
+        }
+
+        errno = 0;
+        auto n = SSL_read(ssl_, buf, buf_len);
+
+        if (n > 0) {
+            return n;
+        }
+
+        auto err = SSL_get_error(ssl_, n);
+
+        if (err == SSL_ERROR_ZERO_RETURN) {
+            shutdown_ = false;
+            return 0;
+        }
+
+#ifndef SSL_OP_IGNORE_UNEXPECTED_EOF
+        // before OpenSSL 3.0 a close without close_notify is reported as a system call error without errno
+        if (err == SSL_ERROR_SYSCALL && n == 0 && errno == 0) {
+            shutdown_ = false;
+            return 0;
+        }
+#endif
+
+        shutdown_ = false;
+        throw std::runtime_error("TLS read failed: " + sslError(ssl_, n));
+    }
+
+    void Connection::write(const void* data, size_t data_len) {
+        auto ptr = static_cast<const uint8_t *>(data);
+        size_t nwrite = 0;
+
+        while (nwrite < data_len) {
+            if (ssl_ == nullptr) {
+                if (auto n = ::write(socket_, ptr + nwrite, data_len - nwrite); n > 0) {
+                    nwrite += n;
+                } else if (n < 0) {
+                    shutdown_ = false;
+                    throw std::runtime_error("write failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+                } else {
+                    shutdown_ = false;
+                    throw std::runtime_error("write failed: connection closed");
+                }
+            } else {
+                size_t n;
+
+                errno = 0;
+                if (auto ret = SSL_write_ex(ssl_, ptr + nwrite, data_len - nwrite, &n); ret > 0) {
+                    nwrite += n;
+                } else {
+                    shutdown_ = false;
+                    throw std::runtime_error("TLS write failed: " + sslError(ssl_, ret));
+                }
+            }
+        }
+    }
+
+    void Connection::writev(const struct iovec* iov, int iov_count) {
+        if (ssl_ != nullptr) {
+            tls_buf_.clear();
+
+            for (int i = 0; i < iov_count; i++) {
+                auto base = static_cast<const uint8_t *>(iov[i].iov_base);
+                tls_buf_.insert(tls_buf_.cend(), base, base + iov[i].iov_len);
+            }
+
+            write(tls_buf_.data(), tls_buf_.size());
+            return;
+        }
+
+        // a short write leaves the rest of the buffers to write, so work on a copy the progress is recorded in
+        iov_.assign(iov, iov + iov_count);
+
+        size_t first = 0;
+
+        while (first < iov_.size()) {
+            auto count = std::min<size_t>(iov_.size() - first, IOV_MAX);
+            auto n = ::writev(socket_, iov_.data() + first, count);
+
+            if (n < 0) {
+                shutdown_ = false;
+                throw std::runtime_error("write failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+            }
+
+            size_t written = n;
+
+            while (first < iov_.size() && written >= iov_[first].iov_len) {
+                written -= iov_[first].iov_len;
+                first++;
+            }
+
+            if (written > 0) {
+                iov_[first].iov_base = static_cast<uint8_t *>(iov_[first].iov_base) + written;
+                iov_[first].iov_len -= written;
+            } else if (n == 0 && first < iov_.size()) {
+                shutdown_ = false;
+                throw std::runtime_error("write failed: connection closed");
+            }
+        }
+    }
+
+    bool Connection::isIdle() const {
+        if (ssl_ != nullptr && SSL_pending(ssl_) > 0) {
+            return false;
+        }
+
+        char c;
+
+        // EOF means the server closed the connection, data means a response was left behind
+        auto n = recv(socket_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
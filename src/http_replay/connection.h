@@ -0,0 +1,82 @@
+#ifndef PACKET_REPLAY_CONNECTION_H
+#define PACKET_REPLAY_CONNECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#include <vector>
+
+typedef struct ssl_st SSL;
+
+namespace packet_replay {
+    /**
+     * A connection to a test server, either plain TCP or TLS over TCP.  The connection owns the socket and the TLS
+     * state and closes them when destroyed.
+     */
+    class Connection {
+        private:
+            int socket_;
+            SSL* ssl_;
+
+            // send a TLS close_notify when closed.  cleared once the connection failed or the server closes it, the
+            // alert could not be delivered and writing it may fail with EPIPE
+            bool shutdown_ = true;
+
+            // scratch space for writing buffers, kept to avoid allocating on every write
+            std::vector<struct iovec> iov_;
+            std::vector<uint8_t> tls_buf_;
+
+            Connection(const Connection&) = delete;
+            Connection& operator=(const Connection&) = delete;
+
+        public:
+            explicit Connection(int socket, SSL* ssl = nullptr) : socket_(socket), ssl_(ssl) {
+            }
+
+            ~Connection();
+
+            int socket() const {
+                return socket_;
+            }
+
+            SSL* ssl() const {
+                return ssl_;
+            }
+
+            /**
+             * Read available data, blocking until some is available.  Throws std::runtime_error on failure.
+             *
+             * @return the number of bytes read or 0 if the server closed the connection
+             */
+            int read(uint8_t* buf, int buf_len);
+
+            /**
+             * Write all the data.  Throws std::runtime_error on failure.
+             */
+            void write(const void* data, size_t data_len);
+
+            /**
+             * Write all the data of the buffers in order.  Plain connections pass the buffers to writev, TLS
+             * connections copy them into one buffer first so they are sent in as few records as possible.  Throws
+             * std::runtime_error on failure.
+             */
+            void writev(const struct iovec* iov, int iov_count);
+
+            /**
+             * Whether the connection is idle and open: no data is waiting to be read and the server has not closed it.
+             */
+            bool isIdle() const;
+
+            /**
+             * Close the connection without a TLS close_notify, e.g. because the server closes it after the last
+             * response or it was found closed in the pool
+             */
+            void skipShutdown() {
+                shutdown_ = false;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "connection_pool.h"
+
+namespace packet_replay {
+    std::unique_ptr<Connection> ConnectionPool::connect(int addr_family, const void* sock_addr, int sock_addr_size, TlsContext* tls) {
+        auto sock = socket(addr_family, SOCK_STREAM, 0);
+        if (sock < 0) {
+            throw std::runtime_error("socket failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+        }
+
+        // connect the client socket to server socket
+        if (::connect(sock, static_cast<const struct sockaddr *>(sock_addr), sock_addr_size) != 0) {
+            auto err = errno;
+            close(sock);
+            throw std::runtime_error("connect failed: " + std::string(strerror(err)) + " (" + std::to_string(err) + ")");
+        }
+
+        if (tls == nullptr) {
+            return std::unique_ptr<Connection>(new Connection(sock));
+        }
+
+        try {
+            return std::unique_ptr<Connection>(new Connection(sock, tls->handshake(sock, sock_addr, sock_addr_size)));
+        } catch (...) {
+            close(sock);
+            throw;
+        }
+    }
+
+    std::unique_ptr<Connection> ConnectionPool::acquire(int addr_family, const void* sock_addr, int sock_addr_size, TlsContext* tls) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = idle_.find(std::string(static_cast<const char *>(sock_addr), sock_addr_size));
+
+            if (it != idle_.end()) {
+                auto& connections = it->second;
+
+                while (!connections.empty()) {
+                    auto connection = std::move(connections.back());
+                    connections.pop_back();
+
+                    if (connection->isIdle()) {
+                        reuses_++;
+                        return connection;
+                    }
+
+                    // closed by the server, or left in an unknown state
+                    connection->skipShutdown();
+                }
+            }
+
+            connects_++;
+        }
+
+        return connect(addr_family, sock_addr, sock_addr_size, tls);
+    }
+
+    void ConnectionPool::release(const void* sock_addr, int sock_addr_size, std::unique_ptr<Connection> connection) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& connections = idle_[std::string(static_cast<const char *>(sock_addr), sock_addr_size)];
+
+        if (connections.size() < max_idle_) {
+            connections.push_back(std::move(connection));
+        }
+    }
+}
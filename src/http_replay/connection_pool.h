@@ -0,0 +1,69 @@
+#ifndef PACKET_REPLAY_CONNECTION_POOL_H
+#define PACKET_REPLAY_CONNECTION_POOL_H
+
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "connection.h"
+#include "tls_context.h"
+
+namespace packet_replay {
+    /**
+     * Idle keep-alive connections to test servers, keyed by the socket address of the server.  A conversation takes
+     * a connection from the pool instead of connecting and returns it instead of closing it, so replaying many short
+     * conversations does not pay for a TCP handshake each time.  The pool may be shared by replay threads.
+     */
+    class ConnectionPool {
+        private:
+            size_t max_idle_;
+            std::mutex mutex_;
+            std::unordered_map<std::string, std::vector<std::unique_ptr<Connection>>> idle_;
+
+            size_t connects_ = 0;
+            size_t reuses_ = 0;
+
+            ConnectionPool(const ConnectionPool&) = delete;
+            ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+        public:
+            /**
+             * @param max_idle the maximum number of idle connections kept per server.  Connections released when the
+             *        limit is reached are closed.
+             */
+            explicit ConnectionPool(size_t max_idle) : max_idle_(max_idle) {
+            }
+
+            /**
+             * Open a new connection to a server
+             *
+             * @param tls the TLS configuration or null for a plain TCP connection
+             */
+            static std::unique_ptr<Connection> connect(int addr_family, const void* sock_addr, int sock_addr_size, TlsContext* tls);
+
+            /**
+             * Get a connection to a server.  Idle connections closed by the server while in the pool are discarded
+             * and a new connection is opened if there is no usable idle connection.
+             */
+            std::unique_ptr<Connection> acquire(int addr_family, const void* sock_addr, int sock_addr_size, TlsContext* tls);
+
+            /**
+             * Return a connection to the pool.  The connection must not have any unread response data.
+             */
+            void release(const void* sock_addr, int sock_addr_size, std::unique_ptr<Connection> connection);
+
+            size_t connects() const {
+                return connects_;
+            }
+
+            size_t reuses() const {
+                return reuses_;
+            }
+    };
+}
+
+#endif
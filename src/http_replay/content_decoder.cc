@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <brotli/decode.h>
+#include <zlib.h>
+
+#include "content_decoder.h"
+
+namespace packet_replay {
+    // window bits for inflateInit2: 15 bit window with automatic zlib / gzip header detection
+    static const int ZLIB_AUTO_WINDOW_BITS = 15 + 32;
+    static const int ZLIB_RAW_WINDOW_BITS = -15;
+
+    ZlibDecoder::ZlibDecoder() : out_buf_(new Bytef[OUTSIZ]), raw_retry_allowed_(true), finished_(false) {
+        memset(&stream_, 0, sizeof(stream_));
+
+        if (inflateInit2(&stream_, ZLIB_AUTO_WINDOW_BITS) != Z_OK) {
+            throw std::runtime_error("inflateInit2 failed");
+        }
+    }
+
+    ZlibDecoder::~ZlibDecoder() {
+        inflateEnd(&stream_);
+    }
+
+    void ZlibDecoder::reset() {
+        // inflateReset2 keeps the allocated window so no memory is allocated between responses
+        if (inflateReset2(&stream_, ZLIB_AUTO_WINDOW_BITS) != Z_OK) {
+            throw std::runtime_error("inflateReset2 failed");
+        }
+
+        raw_retry_allowed_ = true;
+        finished_ = false;
+        consumed_.clear();
+    }
+
+    void ZlibDecoder::decode(const uint8_t* data, int data_len, std::vector<char>& output) {
+        if (finished_) {
+            // trailing bytes after the end of the compressed stream are ignored
+            return;
+        }
+
+        stream_.next_in = const_cast<Bytef *>(data);
+        stream_.avail_in = data_len;
+
+        if (raw_retry_allowed_) {
+            // the header may be split over several calls, e.g. a 1 byte first chunk
+            consumed_.insert(consumed_.cend(), data, data + data_len);
+        }
+
+        while (stream_.avail_in > 0) {
+            stream_.next_out = out_buf_.get();
+            stream_.avail_out = OUTSIZ;
+
+            auto ret = inflate(&stream_, Z_NO_FLUSH);
+
+            if (ret == Z_DATA_ERROR && raw_retry_allowed_) {
+                // "deflate" sent without the zlib wrapper; nothing has been produced yet so restart as a raw stream from
+                // the first byte, which may have been passed in an earlier call.  the current data is the end of
+                // consumed_, it is consumed there
+                raw_retry_allowed_ = false;
+
+                if (inflateReset2(&stream_, ZLIB_RAW_WINDOW_BITS) != Z_OK) {
+                    throw std::runtime_error("inflateReset2 failed");
+                }
+
+                stream_.next_in = consumed_.data();
+                stream_.avail_in = consumed_.size();
+                continue;
+            }
+
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                throw std::runtime_error("failed to decode response body: " + std::string(stream_.msg ? stream_.msg : zError(ret)));
+            }
+
+            auto nout = OUTSIZ - stream_.avail_out;
+
+            if (nout > 0) {
+                raw_retry_allowed_ = false;
+                output.insert(output.cend(), reinterpret_cast<char *>(out_buf_.get()), reinterpret_cast<char *>(out_buf_.get()) + nout);
+            }
+
+            if (ret == Z_STREAM_END) {
+                finished_ = true;
+                break;
+            }
+
+            if (ret == Z_BUF_ERROR && nout == 0) {
+                break;
+            }
+        }
+    }
+
+    BrotliDecoder::BrotliDecoder() : state_(nullptr), out_buf_(new uint8_t[OUTSIZ]), finished_(false) {
+        reset();
+    }
+
+    BrotliDecoder::~BrotliDecoder() {
+        if (state_ != nullptr) {
+            BrotliDecoderDestroyInstance(state_);
+        }
+    }
+
+    void BrotliDecoder::reset() {
+        // the brotli API has no way to reset a decoder so the instance is recreated; the output buffer is kept
+        if (state_ != nullptr) {
+            BrotliDecoderDestroyInstance(state_);
+        }
+
+        state_ = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+
+        if (state_ == nullptr) {
+            throw std::runtime_error("BrotliDecoderCreateInstance failed");
+        }
+
+        finished_ = false;
+    }
+
+    void BrotliDecoder::decode(const uint8_t* data, int data_len, std::vector<char>& output) {
+        if (finished_) {
+            return;
+        }
+
+        size_t avail_in = data_len;
+        const uint8_t* next_in = data;
+
+        while (true) {
+            size_t avail_out = OUTSIZ;
+            uint8_t* next_out = out_buf_.get();
+
+            auto ret = BrotliDecoderDecompressStream(state_, &avail_in, &next_in, &avail_out, &next_out, nullptr);
+
+            if (ret == BROTLI_DECODER_RESULT_ERROR) {
+                throw std::runtime_error("failed to decode response body: " +
+                    std::string(BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state_))));
+            }
+
+            output.insert(output.cend(), reinterpret_cast<char *>(out_buf_.get()), reinterpret_cast<char *>(next_out));
+
+            if (ret == BROTLI_DECODER_RESULT_SUCCESS) {
+                finished_ = true;
+                break;
+            }
+
+            if (ret == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+                break;
+            }
+        }
+    }
+}
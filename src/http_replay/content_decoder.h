@@ -0,0 +1,101 @@
+#ifndef PACKET_REPLAY_CONTENT_DECODER_H
+#define PACKET_REPLAY_CONTENT_DECODER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <zlib.h>
+
+struct BrotliDecoderStateStruct;
+
+namespace packet_replay {
+    /**
+     * Decodes the "content-encoding" of a HTTP response body as it arrives so that bodies are compared by their
+     * decoded content.  Decoders are owned by a HttpResponseProcessor and reset between responses, so the
+     * decompression state and output buffer are allocated once per connection rather than once per response.
+     */
+    class ContentDecoder {
+        public:
+            virtual ~ContentDecoder() {}
+
+            /**
+             * Prepare the decoder for a new response body.
+             */
+            virtual void reset() = 0;
+
+            /**
+             * Decode the next piece of the encoded body.
+             *
+             * @param data the encoded data
+             * @param data_len the number of bytes in data
+             * @param output the buffer the decoded bytes are appended to
+             */
+            virtual void decode(const uint8_t* data, int data_len, std::vector<char>& output) = 0;
+    };
+
+    /**
+     * Decoder for responses without a content encoding.
+     */
+    class IdentityDecoder : public ContentDecoder {
+        public:
+            void reset() override {
+            }
+
+            void decode(const uint8_t* data, int data_len, std::vector<char>& output) override {
+                output.insert(output.cend(), reinterpret_cast<const char *>(data), reinterpret_cast<const char *>(data) + data_len);
+            }
+    };
+
+    /**
+     * Decoder for the "gzip" and "deflate" content encodings.  "deflate" is accepted both with the zlib wrapper
+     * required by RFC 9110 and as a raw deflate stream, which some servers send instead.
+     */
+    class ZlibDecoder : public ContentDecoder {
+        private:
+            constexpr static int OUTSIZ = 64 * 1024;
+
+            z_stream stream_;
+            std::unique_ptr<Bytef[]> out_buf_;
+            bool raw_retry_allowed_;
+            bool finished_;
+
+            // the input consumed before the first output, replayed when the stream turns out to be raw deflate
+            std::vector<Bytef> consumed_;
+
+        public:
+            ZlibDecoder();
+            ~ZlibDecoder();
+
+            ZlibDecoder(const ZlibDecoder&) = delete;
+            ZlibDecoder& operator=(const ZlibDecoder&) = delete;
+
+            void reset() override;
+            void decode(const uint8_t* data, int data_len, std::vector<char>& output) override;
+    };
+
+    /**
+     * Decoder for the "br" content encoding.
+     */
+    class BrotliDecoder : public ContentDecoder {
+        private:
+            constexpr static int OUTSIZ = 64 * 1024;
+
+            BrotliDecoderStateStruct* state_;
+            std::unique_ptr<uint8_t[]> out_buf_;
+            bool finished_;
+
+        public:
+            BrotliDecoder();
+            ~BrotliDecoder();
+
+            BrotliDecoder(const BrotliDecoder&) = delete;
+            BrotliDecoder& operator=(const BrotliDecoder&) = delete;
+
+            void reset() override;
+            void decode(const uint8_t* data, int data_len, std::vector<char>& output) override;
+    };
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "header_rules.h"
+#include "util.h"
+
+namespace packet_replay {
+    static const char WILDCARD[] = "*";
+
+    static inline char lowerAscii(char c) {
+        return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+
+    /**
+     * Orders names by length and then by their lowercase characters.  lower_name must already be lowercase.
+     */
+    static int compareName(const std::string& lower_name, std::string_view name) {
+        if (lower_name.size() != name.size()) {
+            return lower_name.size() < name.size() ? -1 : 1;
+        }
+
+        for (size_t i = 0; i < name.size(); i++) {
+            auto c = lowerAscii(name[i]);
+
+            if (lower_name[i] != c) {
+                return lower_name[i] < c ? -1 : 1;
+            }
+        }
+
+        return 0;
+    }
+
+    static bool equalsIgnoreCase(std::string_view name, std::string_view other) {
+        return name.size() == other.size() && strncasecmp(name.data(), other.data(), name.size()) == 0;
+    }
+
+    HeaderIndex::HeaderIndex() {
+        // the order must match the slot constants
+        add("content-length");
+        add("transfer-encoding");
+        add("content-encoding");
+        add("content-type");
+        add("connection");
+    }
+
+    int HeaderIndex::add(const std::string& name) {
+        std::string lower_name = name;
+        toLower(lower_name);
+
+        auto it = std::lower_bound(entries_.begin(), entries_.end(), lower_name, [](const Entry& entry, const std::string& value) {
+            return compareName(entry.name_, value) < 0;
+        });
+
+        if (it != entries_.end() && (*it).name_ == lower_name) {
+            return (*it).slot_;
+        }
+
+        entries_.insert(it, Entry{lower_name, size_});
+
+        return size_++;
+    }
+
+    int HeaderIndex::find(std::string_view name) const {
+        size_t low = 0;
+        size_t high = entries_.size();
+
+        while (low < high) {
+            auto mid = (low + high) / 2;
+            auto cmp = compareName(entries_[mid].name_, name);
+
+            if (cmp == 0) {
+                return entries_[mid].slot_;
+            } else if (cmp < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        return -1;
+    }
+
+    const HeaderIndex& HeaderIndex::defaultIndex() {
+        static const HeaderIndex index;
+
+        return index;
+    }
+
+    void HeaderRules::addRule(const char* spec) {
+        std::string err = "invalid header rule '";
+        err.append(spec).append("'");
+
+        std::string_view spec_view(spec);
+
+        auto type_end = spec_view.find(':');
+        if (type_end == std::string_view::npos) {
+            throw std::invalid_argument(err);
+        }
+
+        auto name_end = spec_view.find(':', type_end + 1);
+
+        std::string type_token(spec_view.substr(0, type_end));
+        std::string name(spec_view.substr(type_end + 1, name_end == std::string_view::npos ? std::string_view::npos : name_end - type_end - 1));
+
+        toLower(type_token);
+        trim(name);
+
+        if (name.empty()) {
+            throw std::invalid_argument(err);
+        }
+
+        Rule rule;
+
+        if (type_token == "exact") {
+            rule.type_ = Type::EXACT;
+        } else if (type_token == "ignore") {
+            rule.type_ = Type::IGNORE;
+        } else if (type_token == "present") {
+            rule.type_ = Type::PRESENT;
+        } else if (type_token == "regex") {
+            if (name_end == std::string_view::npos) {
+                throw std::invalid_argument(err);
+            }
+
+            rule.type_ = Type::REGEX;
+            rule.regex_ = std::regex(std::string(spec_view.substr(name_end + 1)), std::regex::ECMAScript | std::regex::optimize);
+        } else {
+            throw std::invalid_argument(err);
+        }
+
+        if (rule.type_ != Type::REGEX && name_end != std::string_view::npos) {
+            throw std::invalid_argument(err);
+        }
+
+        if (name == WILDCARD) {
+            if (rule.type_ != Type::EXACT) {
+                throw std::invalid_argument(err + ": only exact rules apply to all headers");
+            }
+
+            compare_all_ = true;
+            return;
+        }
+
+        rule.slot_ = index_.add(name);
+
+        slot_rules_.resize(index_.size(), -1);
+        slot_rules_[rule.slot_] = rules_.size();
+
+        rules_.push_back(std::move(rule));
+    }
+
+    bool HeaderRules::validate(const std::vector<HttpHeader>& expected, const std::vector<std::string_view>& expected_values,
+        const std::vector<HttpHeader>& actual, const std::vector<std::string_view>& actual_values) const {
+
+        for (auto& rule : rules_) {
+            auto expected_value = expected_values[rule.slot_];
+            auto actual_value = actual_values[rule.slot_];
+
+            switch (rule.type_) {
+                case Type::IGNORE:
+                    break;
+
+                case Type::EXACT:
+                    if ((expected_value.data() == nullptr) != (actual_value.data() == nullptr) || expected_value != actual_value) {
+                        return false;
+                    }
+                    break;
+
+                case Type::REGEX:
+                    if (actual_value.data() == nullptr) {
+                        if (expected_value.data() != nullptr) {
+                            return false;
+                        }
+                    } else if (!std::regex_match(actual_value.begin(), actual_value.end(), rule.regex_)) {
+                        return false;
+                    }
+                    break;
+
+                case Type::PRESENT:
+                    if (expected_value.data() != nullptr && actual_value.data() == nullptr) {
+                        return false;
+                    }
+                    break;
+            }
+        }
+
+        if (compare_all_) {
+            for (auto& header : expected) {
+                if (header.slot_ >= 0 && header.slot_ < static_cast<int>(slot_rules_.size()) && slot_rules_[header.slot_] >= 0) {
+                    continue;
+                }
+
+                // headers such as set-cookie can repeat, so look for any header with the same name and value
+                auto found = std::any_of(actual.cbegin(), actual.cend(), [&header](const HttpHeader& actual_header) {
+                    return equalsIgnoreCase(header.name_, actual_header.name_) && header.value_ == actual_header.value_;
+                });
+
+                if (!found) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
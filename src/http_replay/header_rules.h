@@ -0,0 +1,136 @@
+#ifndef PACKET_REPLAY_HEADER_RULES_H
+#define PACKET_REPLAY_HEADER_RULES_H
+
+#include <stddef.h>
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace packet_replay {
+    /**
+     * A parsed HTTP header.  The name and value point into the buffer holding the raw response header.
+     */
+    class HttpHeader {
+        public:
+            std::string_view name_;
+            std::string_view value_;
+
+            // the index of the header in the HeaderIndex or -1 if the header is not indexed
+            int slot_;
+    };
+
+    /**
+     * A table of known header names compiled once, mapping names case insensitively to dense slot numbers.  The
+     * headers the response processor needs itself always occupy the first slots.  Lookups compare the length first
+     * and then the name in place, so no lowercase copy of the name is made.
+     */
+    class HeaderIndex {
+        private:
+            class Entry {
+                public:
+                    std::string name_;
+                    int slot_;
+            };
+
+            // sorted by length then name
+            std::vector<Entry> entries_;
+            int size_ = 0;
+
+        public:
+            static constexpr int CONTENT_LENGTH = 0;
+            static constexpr int TRANSFER_ENCODING = 1;
+            static constexpr int CONTENT_ENCODING = 2;
+            static constexpr int CONTENT_TYPE = 3;
+            static constexpr int CONNECTION = 4;
+
+            HeaderIndex();
+
+            /**
+             * Add a header name to the index
+             *
+             * @return the slot of the header
+             */
+            int add(const std::string& name);
+
+            /**
+             * Find the slot of a header name
+             *
+             * @return the slot of the header or -1 if the header is not in the index
+             */
+            int find(std::string_view name) const;
+
+            /**
+             * The number of slots
+             */
+            int size() const {
+                return size_;
+            }
+
+            /**
+             * The index containing only the headers used by the response processor
+             */
+            static const HeaderIndex& defaultIndex();
+    };
+
+    /**
+     * Rules for validating the headers of a response against the headers of the expected response.  By default
+     * headers are not compared.
+     */
+    class HeaderRules {
+        public:
+            enum class Type {
+                IGNORE,
+                EXACT,
+                REGEX,
+                PRESENT
+            };
+
+            /**
+             * Add a rule from its specification.  Format: <type>:<header name>[:<regex>]
+             *
+             * - exact - the value must match the expected value.  A header name of '*' compares all headers in the
+             *           expected response that do not have another rule
+             * - ignore - the header is never compared
+             * - regex - the value must match the regular expression
+             * - present - the header must be present if it is in the expected response
+             */
+            void addRule(const char* spec);
+
+            const HeaderIndex& getIndex() const {
+                return index_;
+            }
+
+            /**
+             * Validate the headers of a response
+             *
+             * @param expected the headers of the expected response
+             * @param expected_values the values of the expected response indexed by slot, a value with a null data
+             *        pointer is absent
+             * @param actual the headers of the response under test
+             * @param actual_values the values of the response under test indexed by slot
+             *
+             * @return true if the headers pass all the rules
+             */
+            bool validate(const std::vector<HttpHeader>& expected, const std::vector<std::string_view>& expected_values,
+                const std::vector<HttpHeader>& actual, const std::vector<std::string_view>& actual_values) const;
+
+        private:
+            class Rule {
+                public:
+                    Type type_;
+                    int slot_;
+                    std::regex regex_;
+            };
+
+            HeaderIndex index_;
+            std::vector<Rule> rules_;
+
+            // slot to the index of its rule or -1, used by the '*' rule to skip headers with their own rule
+            std::vector<int> slot_rules_;
+            bool compare_all_ = false;
+    };
+}
+
+#endif
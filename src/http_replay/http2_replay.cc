@@ -0,0 +1,486 @@
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nghttp2/nghttp2.h>
+#include <openssl/ssl.h>
+
+#include "action.h"
+#include "connection_pool.h"
+#include "http2_replay.h"
+#include "util.h"
+
+namespace packet_replay {
+    static const int RECV_BUF_SIZE = 64 * 1024;
+
+    // HTTP/1.x headers that are not allowed in HTTP/2 requests (RFC 9113 section 8.2.2)
+    static const char* CONNECTION_HEADERS[] = { "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade", "host" };
+
+    static bool isConnectionHeader(const std::string& name, const std::string& value) {
+        for (auto header : CONNECTION_HEADERS) {
+            if (name == header) {
+                return true;
+            }
+        }
+
+        // "te" is only allowed with the "trailers" value
+        return name == "te" && strcasecmp(value.c_str(), "trailers") != 0;
+    }
+
+    /**
+     * Parse a HTTP/1.x request
+     *
+     * @return the number of bytes of the request or 0 if the data does not contain a full request
+     */
+    static size_t parseRequest(std::string_view data, Http2Request& request) {
+        auto header_end = data.find("\r\n\r\n");
+
+        if (header_end == std::string_view::npos) {
+            return 0;
+        }
+
+        auto line_end = data.find("\r\n");
+        auto request_line = data.substr(0, line_end);
+
+        auto method_end = request_line.find(' ');
+        auto target_end = request_line.rfind(' ');
+
+        if (method_end == std::string_view::npos || target_end == method_end) {
+            throw std::runtime_error("invalid HTTP request line " + std::string(request_line));
+        }
+
+        request.method_ = request_line.substr(0, method_end);
+        request.path_ = request_line.substr(method_end + 1, target_end - method_end - 1);
+        request.authority_.clear();
+        request.headers_.clear();
+        request.body_.clear();
+
+        // absolute form, as sent to proxies
+        if (auto scheme_end = request.path_.find("://"); scheme_end != std::string::npos) {
+            auto path_start = request.path_.find('/', scheme_end + 3);
+
+            request.authority_ = request.path_.substr(scheme_end + 3, path_start == std::string::npos ? std::string::npos : path_start - scheme_end - 3);
+            request.path_ = path_start == std::string::npos ? "/" : request.path_.substr(path_start);
+        }
+
+        size_t content_length = 0;
+
+        while (line_end < header_end) {
+            auto start = line_end + 2;
+            line_end = data.find("\r\n", start);
+
+            auto line = data.substr(start, line_end - start);
+            auto colon = line.find(':');
+
+            if (colon == std::string_view::npos) {
+                continue;
+            }
+
+            std::string name(line.substr(0, colon));
+            std::string value(line.substr(colon + 1));
+
+            trim(name);
+            trim(value);
+            toLower(name);
+
+            if (name == "host") {
+                if (request.authority_.empty()) {
+                    request.authority_ = value;
+                }
+            } else if (name == "transfer-encoding" && strcasecmp(value.c_str(), "identity") != 0) {
+                throw std::runtime_error("transfer encoding " + value + " not supported for HTTP/2 requests");
+            } else if (name == "content-length") {
+                if (std::from_chars(value.data(), value.data() + value.size(), content_length).ec != std::errc()) {
+                    throw std::runtime_error("invalid content-length " + value);
+                }
+            }
+
+            if (!isConnectionHeader(name, value)) {
+                request.headers_.emplace_back(std::move(name), std::move(value));
+            }
+        }
+
+        auto body_start = header_end + 4;
+
+        if (data.size() - body_start < content_length) {
+            return 0;
+        }
+
+        request.body_.insert(request.body_.cend(), data.data() + body_start, data.data() + body_start + content_length);
+
+        return body_start + content_length;
+    }
+
+    static nghttp2_nv makeNv(const std::string& name, const std::string& value) {
+        return nghttp2_nv{
+            reinterpret_cast<uint8_t *>(const_cast<char *>(name.data())),
+            reinterpret_cast<uint8_t *>(const_cast<char *>(value.data())),
+            name.size(),
+            value.size(),
+            NGHTTP2_NV_FLAG_NONE
+        };
+    }
+
+    /**
+     * Run the body of a callback, failing the callback if it throws
+     */
+    template<typename Callback>
+    static auto guard(void* user_data, Callback callback) -> decltype(callback()) {
+        try {
+            return callback();
+        } catch (...) {
+            static_cast<Http2ReplayClient *>(user_data)->fail(std::current_exception());
+            return NGHTTP2_ERR_CALLBACK_FAILURE;
+        }
+    }
+
+    static ssize_t sendCallback(nghttp2_session* session, const uint8_t* data, size_t length, int flags, void* user_data) {
+        return static_cast<Http2ReplayClient *>(user_data)->send(data, length);
+    }
+
+    static int onHeader(nghttp2_session* session, const nghttp2_frame* frame, const uint8_t* name, size_t namelen,
+        const uint8_t* value, size_t valuelen) {
+
+        if (frame->hd.type != NGHTTP2_HEADERS) {
+            return 0;
+        }
+
+        auto exchange = static_cast<Http2ReplayClient::Exchange *>(nghttp2_session_get_stream_user_data(session, frame->hd.stream_id));
+
+        if (exchange == nullptr) {
+            return 0;
+        }
+
+        std::string_view name_view(reinterpret_cast<const char *>(name), namelen);
+        std::string_view value_view(reinterpret_cast<const char *>(value), valuelen);
+
+        if (name_view == ":status") {
+            exchange->status_ = value_view;
+        } else if (name_view[0] != ':' && name_view != "content-length" && name_view != "transfer-encoding") {
+            // the framing headers are replaced when the response is converted to HTTP/1.1
+            exchange->response_header_.append(name_view).append(": ").append(value_view).append("\r\n");
+        }
+
+        return 0;
+    }
+
+    static int onHeaderCallback(nghttp2_session* session, const nghttp2_frame* frame, const uint8_t* name, size_t namelen,
+        const uint8_t* value, size_t valuelen, uint8_t flags, void* user_data) {
+
+        return guard(user_data, [&]() {
+            return onHeader(session, frame, name, namelen, value, valuelen);
+        });
+    }
+
+    static int onDataChunkRecvCallback(nghttp2_session* session, uint8_t flags, int32_t stream_id, const uint8_t* data,
+        size_t len, void* user_data) {
+
+        return guard(user_data, [&]() {
+            auto exchange = static_cast<Http2ReplayClient::Exchange *>(nghttp2_session_get_stream_user_data(session, stream_id));
+
+            if (exchange != nullptr) {
+                exchange->response_body_.insert(exchange->response_body_.cend(), data, data + len);
+            }
+
+            return 0;
+        });
+    }
+
+    static int onFrameRecvCallback(nghttp2_session* session, const nghttp2_frame* frame, void* user_data) {
+        if (frame->hd.type == NGHTTP2_SETTINGS && (frame->hd.flags & NGHTTP2_FLAG_ACK) == 0) {
+            static_cast<Http2ReplayClient *>(user_data)->onSettings();
+        }
+
+        return 0;
+    }
+
+    static int onStreamCloseCallback(nghttp2_session* session, int32_t stream_id, uint32_t error_code, void* user_data) {
+        return guard(user_data, [&]() {
+            static_cast<Http2ReplayClient *>(user_data)->onStreamClose(stream_id, error_code);
+            return 0;
+        });
+    }
+
+    static ssize_t readBodyCallback(nghttp2_session* session, int32_t stream_id, uint8_t* buf, size_t length,
+        uint32_t* data_flags, nghttp2_data_source* source, void* user_data) {
+
+        auto exchange = static_cast<Http2ReplayClient::Exchange *>(source->ptr);
+        auto& body = exchange->request_.body_;
+        auto len = std::min(length, body.size() - exchange->body_sent_);
+
+        memcpy(buf, body.data() + exchange->body_sent_, len);
+        exchange->body_sent_ += len;
+
+        if (exchange->body_sent_ == body.size()) {
+            *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+        }
+
+        return len;
+    }
+
+    Http2ReplayClient::Http2ReplayClient(const HttpReplayOptions& options, int addr_family, const void* sock_addr, int sock_addr_size) :
+        options_(options), addr_family_(addr_family), sock_addr_(new uint8_t[sock_addr_size]), sock_addr_size_(sock_addr_size) {
+
+        memcpy(sock_addr_.get(), sock_addr, sock_addr_size);
+        test_processor_.setHeaderRules(options.header_rules_.get());
+    }
+
+    Http2ReplayClient::~Http2ReplayClient() {
+        if (session_ != nullptr) {
+            nghttp2_session_del(session_);
+        }
+    }
+
+    void Http2ReplayClient::addConversation(TcpConversation* conversation) {
+        std::string requests;
+        std::vector<std::unique_ptr<HttpResponseProcessor>> responses;
+        std::unique_ptr<HttpResponseProcessor> expected;
+
+        while (!conversation->actionEmpty()) {
+            auto action = conversation->actionFront();
+            auto& data = action->data();
+
+            if (action->type_ == Action::Type::SEND) {
+                requests.append(data.data(), data.size());
+            } else if (action->type_ == Action::Type::RECV) {
+                auto ptr = reinterpret_cast<const uint8_t *>(data.data());
+                int remaining = data.size();
+
+                while (remaining > 0) {
+                    if (!expected) {
+                        expected.reset(new HttpResponseProcessor());
+                        expected->setJsonComparator(options_.json_comparator_.get());
+                        expected->setHeaderRules(options_.header_rules_.get());
+                    }
+
+                    auto n = expected->consume(ptr, remaining);
+                    ptr += n;
+                    remaining -= n;
+
+                    if (expected->complete()) {
+                        responses.push_back(std::move(expected));
+                    }
+                }
+            }
+
+            conversation->actionPop();
+        }
+
+        std::string_view pending(requests);
+        size_t response_idx = 0;
+
+        while (!pending.empty()) {
+            std::unique_ptr<Exchange> exchange(new Exchange());
+            auto n = parseRequest(pending, exchange->request_);
+
+            if (n == 0) {
+                // the capture ended in the middle of a request
+                break;
+            }
+
+            pending.remove_prefix(n);
+
+            if (response_idx < responses.size()) {
+                exchange->expected_ = std::move(responses[response_idx++]);
+            }
+
+            exchanges_.push_back(std::move(exchange));
+        }
+    }
+
+    void Http2ReplayClient::connectSession() {
+        connection_ = ConnectionPool::connect(addr_family_, sock_addr_.get(), sock_addr_size_, options_.tls_context_.get());
+
+        if (connection_->ssl() != nullptr) {
+            const unsigned char* alpn = nullptr;
+            unsigned int alpn_len = 0;
+
+            SSL_get0_alpn_selected(connection_->ssl(), &alpn, &alpn_len);
+
+            if (alpn_len != 2 || memcmp(alpn, "h2", 2) != 0) {
+                throw std::runtime_error("server did not negotiate HTTP/2");
+            }
+        }
+
+        nghttp2_session_callbacks* callbacks;
+        nghttp2_session_callbacks_new(&callbacks);
+        nghttp2_session_callbacks_set_send_callback(callbacks, sendCallback);
+        nghttp2_session_callbacks_set_on_header_callback(callbacks, onHeaderCallback);
+        nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, onDataChunkRecvCallback);
+        nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, onFrameRecvCallback);
+        nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, onStreamCloseCallback);
+
+        auto rv = nghttp2_session_client_new(&session_, callbacks, this);
+        nghttp2_session_callbacks_del(callbacks);
+
+        if (rv != 0) {
+            throw std::runtime_error("nghttp2_session_client_new failed: " + std::string(nghttp2_strerror(rv)));
+        }
+
+        nghttp2_settings_entry settings[] = {
+            { NGHTTP2_SETTINGS_ENABLE_PUSH, 0 },
+            { NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, WINDOW_SIZE }
+        };
+
+        if ((rv = nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings, sizeof(settings) / sizeof(settings[0]))) != 0 ||
+            (rv = nghttp2_session_set_local_window_size(session_, NGHTTP2_FLAG_NONE, 0, WINDOW_SIZE)) != 0) {
+            throw std::runtime_error("HTTP/2 settings failed: " + std::string(nghttp2_strerror(rv)));
+        }
+    }
+
+    ssize_t Http2ReplayClient::send(const uint8_t* data, size_t length) {
+        return guard(this, [&]() -> ssize_t {
+            connection_->write(data, length);
+            return length;
+        });
+    }
+
+    void Http2ReplayClient::fail(std::exception_ptr error) {
+        if (!error_) {
+            error_ = error;
+        }
+    }
+
+    void Http2ReplayClient::rethrowError() {
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+    void Http2ReplayClient::sendPending() {
+        auto rv = nghttp2_session_send(session_);
+        rethrowError();
+
+        if (rv != 0) {
+            throw std::runtime_error("HTTP/2 send failed: " + std::string(nghttp2_strerror(rv)));
+        }
+    }
+
+    void Http2ReplayClient::submitRequests() {
+        static const std::string METHOD = ":method";
+        static const std::string SCHEME = ":scheme";
+        static const std::string AUTHORITY = ":authority";
+        static const std::string PATH = ":path";
+        static const std::string HTTP = "http";
+
+        // the server's stream limit is unbounded until its SETTINGS frame arrives, streams opened before then may be
+        // refused
+        if (options_.max_streams_ == 0 && !remote_settings_) {
+            return;
+        }
+
+        std::vector<nghttp2_nv> nva;
+        uint32_t max_streams = options_.max_streams_ > 0 ? options_.max_streams_ :
+            nghttp2_session_get_remote_settings(session_, NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS);
+
+        while (static_cast<uint32_t>(open_streams_) < max_streams && next_exchange_ < exchanges_.size()) {
+            auto exchange = exchanges_[next_exchange_].get();
+            auto& request = exchange->request_;
+
+            nva.clear();
+            nva.push_back(makeNv(METHOD, request.method_));
+            nva.push_back(makeNv(SCHEME, HTTP));
+            nva.push_back(makeNv(AUTHORITY, request.authority_));
+            nva.push_back(makeNv(PATH, request.path_));
+
+            for (auto& header : request.headers_) {
+                nva.push_back(makeNv(header.first, header.second));
+            }
+
+            nghttp2_data_provider provider;
+            provider.source.ptr = exchange;
+            provider.read_callback = readBodyCallback;
+
+            auto stream_id = nghttp2_submit_request(session_, nullptr, nva.data(), nva.size(), request.body_.empty() ? nullptr : &provider, exchange);
+
+            if (stream_id < 0) {
+                throw std::runtime_error("HTTP/2 request failed: " + std::string(nghttp2_strerror(stream_id)));
+            }
+
+            open_streams_++;
+            next_exchange_++;
+        }
+    }
+
+    void Http2ReplayClient::onSettings() {
+        remote_settings_ = true;
+    }
+
+    void Http2ReplayClient::onStreamClose(int32_t stream_id, uint32_t error_code) {
+        auto exchange = static_cast<Exchange *>(nghttp2_session_get_stream_user_data(session_, stream_id));
+
+        if (exchange == nullptr) {
+            return;
+        }
+
+        open_streams_--;
+        completed_++;
+
+        if (error_code != NGHTTP2_NO_ERROR) {
+            std::cout << "detected difference in server response: stream reset (" << nghttp2_http2_strerror(error_code) << ")" << std::endl;
+        } else {
+            // convert the response to HTTP/1.1 so that it is processed like the captured response
+            std::string header = "HTTP/1.1 " + exchange->status_ + " \r\n" + exchange->response_header_ +
+                "content-length: " + std::to_string(exchange->response_body_.size()) + "\r\n\r\n";
+
+            test_processor_.reset();
+            test_processor_.consume(reinterpret_cast<const uint8_t *>(header.data()), header.size());
+            test_processor_.consume(reinterpret_cast<const uint8_t *>(exchange->response_body_.data()), exchange->response_body_.size());
+
+            if (exchange->expected_ && exchange->expected_->compare(test_processor_)) {
+                std::cout << "detected difference in server response" << std::endl;
+            }
+        }
+
+        // release the stream's buffers now rather than when the whole replay is done
+        exchange->response_body_ = std::vector<char>();
+        exchange->request_.body_ = std::vector<char>();
+        exchange->expected_.reset();
+    }
+
+    void Http2ReplayClient::replay() {
+        if (exchanges_.empty()) {
+            return;
+        }
+
+        connectSession();
+        submitRequests();
+
+        std::unique_ptr<uint8_t[]> buffer(new uint8_t[RECV_BUF_SIZE]);
+
+        while (completed_ < exchanges_.size()) {
+            sendPending();
+
+            if (!nghttp2_session_want_read(session_)) {
+                throw std::runtime_error("HTTP/2 connection closed by server with " + std::to_string(exchanges_.size() - completed_) + " requests outstanding");
+            }
+
+            auto n = connection_->read(buffer.get(), RECV_BUF_SIZE);
+
+            if (n == 0) {
+                throw std::runtime_error("read failed: connection closed");
+            }
+
+            auto rv = nghttp2_session_mem_recv(session_, buffer.get(), n);
+            rethrowError();
+
+            if (rv < 0) {
+                throw std::runtime_error("HTTP/2 receive failed: " + std::string(nghttp2_strerror(rv)));
+            }
+
+            submitRequests();
+        }
+
+        nghttp2_session_terminate_session(session_, NGHTTP2_NO_ERROR);
+        sendPending();
+    }
+}
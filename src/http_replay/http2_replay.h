@@ -0,0 +1,116 @@
+#ifndef PACKET_REPLAY_HTTP2_REPLAY_H
+#define PACKET_REPLAY_HTTP2_REPLAY_H
+
+#include <stdint.h>
+
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "connection.h"
+#include "http_replay.h"
+#include "http_response_processor.h"
+#include "tcp_conversation.h"
+
+typedef struct nghttp2_session nghttp2_session;
+
+namespace packet_replay {
+    /**
+     * A HTTP/1.x request from the capture, split into the parts needed to send it as a HTTP/2 request
+     */
+    class Http2Request {
+        public:
+            std::string method_;
+            std::string path_;
+            std::string authority_;
+
+            // header names are lowercase and connection specific headers are removed
+            std::vector<std::pair<std::string, std::string>> headers_;
+            std::vector<char> body_;
+    };
+
+    /**
+     * A HTTP/2 client (h2 negotiated with ALPN over TLS, otherwise h2c with prior knowledge) that replays the HTTP/1.x requests of one or more captured
+     * conversations as streams of a single multiplexed connection.  Responses are converted back to HTTP/1.1 so they
+     * are validated the same way as replayed HTTP/1.x responses.
+     *
+     * The HPACK tables live as long as the connection, so headers repeated across requests are sent as indices.
+     */
+    class Http2ReplayClient {
+        public:
+            // initial stream and connection flow control window.  large enough that responses are not throttled
+            // by window updates
+            constexpr static int32_t WINDOW_SIZE = 16 * 1024 * 1024;
+
+            /**
+             * Per stream state
+             */
+            class Exchange {
+                public:
+                    Http2Request request_;
+                    std::unique_ptr<HttpResponseProcessor> expected_;
+
+                    // the live response converted to HTTP/1.1
+                    std::string response_header_;
+                    std::vector<char> response_body_;
+                    std::string status_;
+                    size_t body_sent_ = 0;
+            };
+
+            Http2ReplayClient(const HttpReplayOptions& options, int addr_family, const void* sock_addr, int sock_addr_size);
+            ~Http2ReplayClient();
+
+            /**
+             * Add the request/response pairs of a conversation.  The actions of the conversation are consumed.
+             */
+            void addConversation(TcpConversation* conversation);
+
+            /**
+             * Send all requests, keeping as many streams open at a time as the server allows or as the configured
+             * pipeline depth when set
+             */
+            void replay();
+
+            // nghttp2 callbacks
+            void onSettings();
+            void onStreamClose(int32_t stream_id, uint32_t error_code);
+            ssize_t send(const uint8_t* data, size_t length);
+
+            /**
+             * Record an exception thrown by a callback.  Exceptions must not unwind through nghttp2, the callback
+             * fails instead and the first exception is rethrown once nghttp2 returns.
+             */
+            void fail(std::exception_ptr error);
+
+        private:
+            const HttpReplayOptions& options_;
+            int addr_family_;
+            std::unique_ptr<uint8_t[]> sock_addr_;
+            int sock_addr_size_;
+            std::unique_ptr<Connection> connection_;
+            nghttp2_session* session_ = nullptr;
+
+            std::vector<std::unique_ptr<Exchange>> exchanges_;
+            size_t next_exchange_ = 0;
+            int open_streams_ = 0;
+            size_t completed_ = 0;
+
+            // set once the server's SETTINGS frame with its stream limit is received
+            bool remote_settings_ = false;
+
+            HttpResponseProcessor test_processor_;
+            std::exception_ptr error_;
+
+            Http2ReplayClient(const Http2ReplayClient&) = delete;
+            Http2ReplayClient& operator=(const Http2ReplayClient&) = delete;
+
+            void connectSession();
+            void submitRequests();
+            void sendPending();
+            void rethrowError();
+    };
+}
+
+#endif
@@ -1,3 +1,4 @@
+#include <signal.h>
 #include <stdint.h>
 #include <unistd.h>
 
@@ -5,120 +6,602 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <exception>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "action.h"
 #include "capture.h"
+#include "compression.h"
+#include "connection_pool.h"
 #include "conversation_serializer.h"
+#include "data_feeder.h"
+#include "http2_replay.h"
 #include "http_replay.h"
 #include "http_response_processor.h"
+#include "payload_store.h"
 #include "tcp_conversation.h"
 
 namespace packet_replay {
-    void HttpReplayClient::replay() {
+    static const char* INCOMPLETE_RESPONSE = "captured response is incomplete, server response not compared";
+
+    void HttpValidationJob::validate(PacketValidator*) {
+        if (!expected_->complete()) {
+            incomplete_ = true;
+            return;
+        }
+
+        different_ = expected_->compare(*actual_) != 0;
+    }
+
+    void HttpValidationJob::report() {
+        if (incomplete_) {
+            std::cout << INCOMPLETE_RESPONSE << std::endl;
+        } else if (different_) {
+            std::cout << "detected difference in server response" << std::endl;
+        }
+
+        spare_.push_back(std::move(expected_));
+        spare_.push_back(std::move(actual_));
+    }
+
+    std::unique_ptr<HttpResponseProcessor> HttpReplayClient::createProcessor() {
+        std::unique_ptr<HttpResponseProcessor> processor;
+
+        if (spare_.empty()) {
+            processor.reset(new HttpResponseProcessor());
+            processor->setJsonComparator(options_.json_comparator_.get());
+            processor->setHeaderRules(options_.header_rules_.get());
+        } else {
+            processor = std::move(spare_.back());
+            spare_.pop_back();
+            processor->reset();
+        }
+
+        return processor;
+    }
+
+    static bool startsResponse(const uint8_t* data, int data_len) {
+        static const std::string_view STATUS_LINE_START = "HTTP/";
+
+        auto len = std::min<size_t>(data_len, STATUS_LINE_START.size());
+
+        return STATUS_LINE_START.compare(0, len, std::string_view(reinterpret_cast<const char *>(data), len)) == 0;
+    }
+
+    void HttpReplayClient::processExpectedData(const uint8_t* data, int data_len) {
+        if (interrupted_ && data_len > 0) {
+            interrupted_ = false;
+
+            if (startsResponse(data, data_len)) {
+                endExpected();
+            }
+        }
+
+        auto ptr = data;
+        int remaining = data_len;
+
+        // a captured segment can hold the end of one response and the start of the next
+        while (remaining > 0) {
+            if (!expected_) {
+                expected_ = createProcessor();
+                expected_response_ = startsResponse(ptr, remaining);
+            }
+
+            auto n = expected_->consume(ptr, remaining);
+            ptr += n;
+            remaining -= n;
+
+            if (expected_->complete()) {
+                pending_.push_back(std::move(expected_));
+            }
+        }
+    }
+
+    void HttpReplayClient::endExpected() {
+        // the live response to a captured response cut short is still read, so the later responses are compared with
+        // the right captured responses.  stray bytes are dropped, the server sent no response for them
+        if (expected_ && expected_response_) {
+            pending_.push_back(std::move(expected_));
+        } else if (expected_) {
+            if (expected_->getExtractionRules() != nullptr) {
+                pending_extractions_--;
+            }
+
+            expected_.reset();
+        }
+
+        interrupted_ = false;
+    }
+
+    void HttpReplayClient::receiveResponse() {
+        // a response compared asynchronously is kept until it is compared, so it needs its own processor
+        std::unique_ptr<HttpResponseProcessor> actual;
+
+        if (validation_queue_) {
+            actual = createProcessor();
+        } else {
+            test_processor_.reset();
+        }
+
+        auto& processor = actual ? *actual : test_processor_;
+
+        while (!processor.complete()) {
+            if (recv_start_ == recv_end_) {
+                if (auto n = connection_->read(recv_buf_.get(), RECV_BUF_SIZE); n > 0) {
+                    recv_start_ = 0;
+                    recv_end_ = n;
+                } else {
+                    throw std::runtime_error("read failed: connection closed");
+                }
+            }
+
+            recv_start_ += processor.consume(recv_buf_.get() + recv_start_, recv_end_ - recv_start_);
+        }
+
+        auto expected = std::move(pending_.front());
+        pending_.pop_front();
+        keep_alive_ = keep_alive_ && processor.keepAlive();
+
+        if (auto rules = expected->getExtractionRules(); rules != nullptr) {
+            extract(*rules, processor);
+            pending_extractions_--;
+        }
+
+        if (validation_queue_) {
+            validation_queue_->submit(std::unique_ptr<ValidationJob>(new HttpValidationJob(std::move(expected), std::move(actual), spare_)));
+            return;
+        }
+
+        if (!expected->complete()) {
+            std::cout << INCOMPLETE_RESPONSE << std::endl;
+        } else if (expected->compare(test_processor_)) {
+            std::cout << "detected difference in server response" << std::endl;
+        }
+
+        spare_.push_back(std::move(expected));
+    }
+
+    void HttpReplayClient::extract(const std::vector<ExtractionRule>& rules, const HttpResponseProcessor& response) {
+        auto header = response.header();
+        auto& body = response.body();
 
-        HttpResponseProcessor expected_processor;
-        HttpResponseProcessor test_processor;
+        for (auto& rule : rules) {
+            // offsets are into the body, the other rules search the headers first
+            if (rule.type() != ExtractionRule::Type::OFFSET && rule.extract(header.data(), header.size(), variables_)) {
+                continue;
+            }
+
+            if (!rule.extract(body.data(), body.size(), variables_)) {
+                std::cout << "extraction rule '" << rule.spec() << "' found no value in server response" << std::endl;
+            }
+        }
+    }
+
+    void HttpReplayClient::closeConnection() {
+        endExpected();
+
+        while (!pending_.empty()) {
+            receiveResponse();
+        }
+
+        // only a connection the server keeps open, with no unread data, can be used by another conversation
+        if (options_.connection_pool_ && keep_alive_ && recv_start_ == recv_end_) {
+            options_.connection_pool_->release(conversation_->getTestSockAddr(), conversation_->getSockAddrSize(), std::move(connection_));
+        } else if (connection_ && !keep_alive_) {
+            // the server closes the connection after the last response
+            connection_->skipShutdown();
+        }
 
-        while (!conversation_->actionEmpty()) {
-            auto action = conversation_->actionFront();
+        connection_.reset();
+    }
+
+    void HttpReplayClient::replay() {
+        for (auto action : conversation_->getActionQueue()) {
 
             switch (action->type_) {
                 case Action::Type::CONNECT: {
-                    socket_ = socket(conversation_->getAddressFamily(), SOCK_STREAM, 0);
-                    if (socket_ < 0) {
-                        throw std::runtime_error("socket failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+                    if (options_.connection_pool_) {
+                        connection_ = options_.connection_pool_->acquire(conversation_->getAddressFamily(), conversation_->getTestSockAddr(),
+                            conversation_->getSockAddrSize(), options_.tls_context_.get());
+                    } else {
+                        connection_ = ConnectionPool::connect(conversation_->getAddressFamily(), conversation_->getTestSockAddr(),
+                            conversation_->getSockAddrSize(), options_.tls_context_.get());
                     }
 
-                    // connect the client socket to server socket
-                    if (connect(socket_, (struct sockaddr *) conversation_->getTestSockAddr(), conversation_->getSockAddrSize()) != 0) {
-                        throw std::runtime_error("connect failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
-                    }
+                    recv_start_ = 0;
+                    recv_end_ = 0;
+                    expected_.reset();
+                    interrupted_ = false;
+                    keep_alive_ = true;
+                    pending_extractions_ = 0;
 
                     break;
                 }
 
                 case Action::Type::SEND: {
-                    auto nwrite = 0;
-                    auto data = action->data();
-                    auto data_size = data.size();
-                    
-                    while (nwrite < data_size) {
-                        if (auto n = write(socket_, data.data() + nwrite, data_size - nwrite); n > 0) {
-                            nwrite += n;
-                        } else if (n < 0) {
-                            throw std::runtime_error("write failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
-                        } else {
-                            throw std::runtime_error("write failed: connection closed");
-                        }
+                    interrupted_ = expected_ != nullptr;
+
+                    // the responses of the captured requests so far are known at this point.  wait for enough of them
+                    // to stay within the pipeline depth before sending more
+                    while (static_cast<int>(pending_.size()) >= options_.pipeline_depth_) {
+                        receiveResponse();
                     }
 
-                    // this assumes that response for the current request arrives before the another request starts.  Although this isn't strictly a requirement
-                    // for http, it should be true almost all of the time.
-                    expected_processor.reset();
-                    test_processor.reset();
+                    // a request with variables may use values extracted from the responses not read yet
+                    while (action->getTemplate() != nullptr && pending_extractions_ > 0 && !pending_.empty()) {
+                        receiveResponse();
+                    }
+
+                    if (auto action_template = action->getTemplate(); action_template != nullptr) {
+                        // the request is written from the literal text of the action and the values of the variables
+                        action_template->gather(variables_, iov_, content_length_);
+                        connection_->writev(iov_.data(), iov_.size());
+                    } else {
+                        auto& data = action->data();
+                        connection_->write(data.data(), data.size());
+                    }
 
                     break;
                 }
 
-                case Action::Type::RECV: {
-                    if (!expected_processor.complete()) {
-                        expected_processor.processData(action->data());
+                case Action::Type::RECV:
+                    // expected data with variables may use values extracted from the responses not read yet as well
+                    while (action->getTemplate() != nullptr && pending_extractions_ > 0 && !pending_.empty()) {
+                        receiveResponse();
                     }
 
-                    uint8_t buffer[BUFSIZ];
-                                        
-                    while (!test_processor.complete()) {
-                        if (auto n = read(socket_, buffer, BUFSIZ); n > 0) {
-                            test_processor.processData(buffer, n);
-                        } else if (n < 0) {
-                            throw std::runtime_error("read failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
-                        } else {
-                            throw std::runtime_error("read failed: connection closed");
-                        }    
-                    }
+                    if (auto action_template = action->getTemplate(); action_template != nullptr) {
+                        action_template->gather(variables_, iov_, content_length_);
 
-                    if (expected_processor.complete()) {
-                        if (expected_processor.compare(test_processor)) {
-                            std::cout << "detected difference in server response" << std::endl;
+                        for (auto& piece : iov_) {
+                            processExpectedData(static_cast<const uint8_t *>(piece.iov_base), piece.iov_len);
                         }
+                    } else {
+                        processExpectedData(reinterpret_cast<const uint8_t *>(action->data().data()), action->data().size());
                     }
 
+                    // the rules apply to the last response the data is part of
+                    if (!action->getExtractionRules().empty()) {
+                        auto expected = expected_ ? expected_.get() : pending_.empty() ? nullptr : pending_.back().get();
+
+                        if (expected != nullptr && expected->getExtractionRules() == nullptr) {
+                            expected->setExtractionRules(&action->getExtractionRules());
+                            pending_extractions_++;
+                        }
+                    }
                     break;
-                }
 
                 case Action::Type::CLOSE:
-                    close(socket_);
-                    socket_ = -1;
+                    closeConnection();
                     break;
 
             }
+        }
 
-            conversation_->actionPop();
+        if (connection_) {
+            closeConnection();
+        }
 
+        if (validation_queue_) {
+            validation_queue_->finish();
         }
     }
 }
 
 static void printUsage(const char* name) {
-    std::cerr << "Usage: " << name << "[-c <client spec>] <cap file>" << std::endl;
+    std::cerr << "Usage: " << name << "[-c <client spec>] [-j] [-i <ignored JSON path>] [-H <header rule>] [-p <pipeline depth>] [-P <max idle connections>] [-2] [-t] [-n <server name>] [-a <validation threads>] [-s] [-D <name>=<value>] [-f <data file>] [-m <sequential|random|unique>] [-U <virtual users>] [-r <replays per user>] [-d] [-z <dictionary file>] <cap file | script file>" << std::endl;
+}
+
+static void replayCapture(const char* file, packet_replay::TypedConversationStore<packet_replay::TcpConversation>& store,
+    packet_replay::PayloadStore* payloads, const packet_replay::CompressionDictionary* dictionary,
+    const packet_replay::HttpReplayOptions& options) {
+    packet_replay::Capture capture(store);
+
+    capture.setDictionary(dictionary);
+
+    // store.addConfiguredConversation("127.0.0.1:63596");
+    // store.addTargetTestServer("192.168.1.72:64501");
+    // store.addConfiguredConversation("127.0.0.1");
+    // store.addTargetTestServer("[2001:569:7e46:700:1d87:a4a6:9ef8:5dd]:62051:[2606:4700:3030::6815:5001]:80");
+    // store.addTargetTestServer("2001:569:7e46:700:1d87:a4a6:9ef8:5dd:62058");
+
+    capture.load(file);
+
+    if (payloads != nullptr) {
+        for (auto conv : store.getConversations()) {
+            for (auto action : conv->getActionQueue()) {
+                payloads->intern(*action);
+            }
+        }
+    }
+
+    if (options.http2_) {
+        // one connection per test server, keyed by its socket address
+        std::map<std::string, std::unique_ptr<packet_replay::Http2ReplayClient>> clients;
+
+        for (auto conv : store.getConversations()) {
+            std::string key(static_cast<const char *>(conv->getTestSockAddr()), conv->getSockAddrSize());
+            auto& client = clients[key];
+
+            if (!client) {
+                client.reset(new packet_replay::Http2ReplayClient(options, conv->getAddressFamily(), conv->getTestSockAddr(), conv->getSockAddrSize()));
+            }
+
+            client->addConversation(conv);
+        }
+
+        for (auto& entry : clients) {
+            entry.second->replay();
+        }
+    } else {
+        for (auto conv : store.getConversations()) {
+            packet_replay::HttpReplayClient client(conv, options);
+
+//                packet_replay::ConversationSerializer().write(std::cout, conv);
+            client.replay();
+        }
+    }
+}
+
+/**
+ * Settings of a script replay
+ */
+struct ScriptOptions {
+    std::vector<std::pair<std::string, std::string>> definitions_;
+
+    // variable values for each replay, read from this file when set
+    std::string data_file_;
+    packet_replay::DataFeeder::Mode data_mode_ = packet_replay::DataFeeder::Mode::SEQUENTIAL;
+
+    // the number of threads replaying the script and the number of replays by each of them
+    int users_ = 1;
+    int replays_ = 1;
+};
+
+static void replayScript(const char* file, const ScriptOptions& script_options, packet_replay::PayloadStore* payloads,
+    const packet_replay::CompressionDictionary* dictionary, packet_replay::HttpReplayOptions& options) {
+
+    packet_replay::ConversationSerializer serializer;
+
+    serializer.setPayloadStore(payloads);
+    serializer.setDictionary(dictionary);
+
+    auto conversation = serializer.load(file);
+    std::unique_ptr<packet_replay::DataFeeder> feeder;
+
+    if (!script_options.data_file_.empty()) {
+        feeder.reset(new packet_replay::DataFeeder(script_options.data_file_, script_options.data_mode_));
+        feeder->bind(serializer.variables());
+    }
+
+    for (auto& definition : script_options.definitions_) {
+        options.variables_.set(serializer.variables().add(definition.first), definition.second);
+    }
+
+    for (auto action : conversation->getActionQueue()) {
+        if (auto action_template = action->getTemplate(); action_template != nullptr) {
+            action_template->computeContentLength();
+        }
+    }
+
+    auto tcp_conversation = static_cast<packet_replay::TcpConversation *>(conversation.get());
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> replays(0);
+    std::mutex mutex;
+    std::exception_ptr error;
+
+    // each thread is a virtual user replaying the script with its own client, each replay with the next row of data
+    auto worker = [&]() {
+        try {
+            std::unique_ptr<packet_replay::DataFeeder::Cursor> cursor;
+
+            if (feeder) {
+                cursor.reset(new packet_replay::DataFeeder::Cursor(feeder->cursor()));
+            }
+
+            for (int i = 0; i < script_options.replays_ && !stop; i++) {
+                packet_replay::HttpReplayClient client(tcp_conversation, options);
+
+                if (feeder && !feeder->fill(*cursor, client.variables())) {
+                    break;
+                }
+
+                client.replay();
+                replays++;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!error) {
+                error = std::current_exception();
+            }
+
+            // stop the other users after their current replay
+            stop = true;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < script_options.users_; i++) {
+        workers.emplace_back(worker);
+    }
+
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (script_options.users_ > 1 || script_options.replays_ > 1) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        auto rate = elapsed.count() > 0 ? static_cast<uint64_t>(replays / elapsed.count()) : 0;
+
+        std::cerr << "replayed script " << replays << " times in " << elapsed.count() << "s (" << rate << " replays/sec)" << std::endl;
+    }
+
+    if (feeder) {
+        std::cerr << "data rows taken: " << feeder->used() << ", rows in file: " << feeder->rows() << std::endl;
+    }
 }
 
+// the number of responses queued for asynchronous comparison
+static const size_t VALIDATION_QUEUE_SIZE = 1024;
+
 int main(int argc, char* argv[]) {
+    // a server closing a connection, e.g. an idle pooled one, makes writes fail with EPIPE instead of killing the
+    // process
+    signal(SIGPIPE, SIG_IGN);
+
     try {
         packet_replay::TcpConversationFactory factory;
         packet_replay::TypedConversationStore<packet_replay::TcpConversation> store(factory);
+        packet_replay::HttpReplayOptions options;
+        bool tls = false;
+        std::string server_name;
+        int validation_threads = 0;
+        bool script = false;
+        ScriptOptions script_options;
+
+        // set to keep each distinct action payload in memory once
+        std::unique_ptr<packet_replay::PayloadStore> payloads;
+
+        // the dictionary compressed captures or scripts were compressed with
+        std::unique_ptr<packet_replay::CompressionDictionary> dictionary;
 
         int opt;
-        while((opt = getopt(argc, argv, "c:")) != -1) {  
+        while((opt = getopt(argc, argv, "c:ji:H:p:P:2tn:a:sD:f:m:U:r:dz:")) != -1) {  
             switch(opt)  
             {  
                 case 'c':  
                     store.addTargetTestServer(optarg);
                     break;  
 
+                case 'j':
+                    if (!options.json_comparator_) {
+                        options.json_comparator_.reset(new packet_replay::JsonComparator());
+                    }
+                    break;
+
+                case 'i':
+                    if (!options.json_comparator_) {
+                        options.json_comparator_.reset(new packet_replay::JsonComparator());
+                    }
+                    options.json_comparator_->addIgnoredPath(optarg);
+                    break;
+
+                case 'H':
+                    if (!options.header_rules_) {
+                        options.header_rules_.reset(new packet_replay::HeaderRules());
+                    }
+                    options.header_rules_->addRule(optarg);
+                    break;
+
+                case 'p':
+                    options.pipeline_depth_ = std::stoi(optarg);
+
+                    if (options.pipeline_depth_ < 1) {
+                        throw std::invalid_argument("invalid pipeline depth '" + std::string(optarg) + "'");
+                    }
+
+                    options.max_streams_ = options.pipeline_depth_;
+                    break;
+
+                case 'P': {
+                    auto max_idle = std::stoi(optarg);
+
+                    if (max_idle < 1) {
+                        throw std::invalid_argument("invalid maximum idle connections '" + std::string(optarg) + "'");
+                    }
+
+                    options.connection_pool_.reset(new packet_replay::ConnectionPool(max_idle));
+                    break;
+                }
+
+                case '2':
+                    options.http2_ = true;
+                    break;
+
+                case 't':
+                    tls = true;
+                    break;
+
+                case 'n':
+                    tls = true;
+                    server_name = optarg;
+                    break;
+
+                case 'a':
+                    validation_threads = std::stoi(optarg);
+
+                    if (validation_threads < 1) {
+                        throw std::invalid_argument("invalid number of validation threads '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 's':
+                    script = true;
+                    break;
+
+                case 'D': {
+                    std::string definition(optarg);
+                    auto separator = definition.find('=');
+
+                    if (separator == std::string::npos || separator == 0) {
+                        throw std::invalid_argument("invalid variable definition '" + definition + "'");
+                    }
+
+                    script_options.definitions_.emplace_back(definition.substr(0, separator), definition.substr(separator + 1));
+                    break;
+                }
+
+                case 'f':
+                    script_options.data_file_ = optarg;
+                    break;
+
+                case 'm':
+                    script_options.data_mode_ = packet_replay::DataFeeder::parseMode(optarg);
+                    break;
+
+                case 'U':
+                    script_options.users_ = std::stoi(optarg);
+
+                    if (script_options.users_ < 1) {
+                        throw std::invalid_argument("invalid number of virtual users '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'r':
+                    script_options.replays_ = std::stoi(optarg);
+
+                    if (script_options.replays_ < 1) {
+                        throw std::invalid_argument("invalid number of replays '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'd':
+                    payloads.reset(new packet_replay::PayloadStore());
+                    break;
+
+                case 'z':
+                    dictionary.reset(new packet_replay::CompressionDictionary(optarg));
+                    break;
+
                 default:
                     printUsage(argv[0]);
                     return -1;
@@ -130,21 +613,40 @@ int main(int argc, char* argv[]) {
             return -1;
         }
 
-        packet_replay::Capture capture(store);
+        if (script && options.http2_) {
+            throw std::invalid_argument("scripts cannot be replayed over HTTP/2");
+        }
 
-        // store.addConfiguredConversation("127.0.0.1:63596");
-        // store.addTargetTestServer("192.168.1.72:64501");
-        // store.addConfiguredConversation("127.0.0.1");
-        // store.addTargetTestServer("[2001:569:7e46:700:1d87:a4a6:9ef8:5dd]:62051:[2606:4700:3030::6815:5001]:80");
-        // store.addTargetTestServer("2001:569:7e46:700:1d87:a4a6:9ef8:5dd:62058");
+        if (!script && (!script_options.data_file_.empty() || script_options.users_ > 1 || script_options.replays_ > 1)) {
+            throw std::invalid_argument("data files, virtual users and repeated replays require a script");
+        }
 
-        capture.load(argv[optind]);
+        if (tls) {
+            options.tls_context_.reset(new packet_replay::TlsContext(server_name, options.http2_));
+        }
 
-        for (auto conv : store.getConversations()) {
-            packet_replay::HttpReplayClient client(conv);
+        if (validation_threads > 0) {
+            options.validation_pipeline_.reset(new packet_replay::ValidationPipeline(validation_threads, VALIDATION_QUEUE_SIZE, nullptr));
+        }
 
-//            packet_replay::ConversationSerializer().write(std::cout, conv);
-            client.replay();
+        if (script) {
+            replayScript(argv[optind], script_options, payloads.get(), dictionary.get(), options);
+        } else {
+            replayCapture(argv[optind], store, payloads.get(), dictionary.get(), options);
+        }
+
+        if (payloads) {
+            std::cerr << "distinct payloads: " << payloads->payloads() << ", bytes stored: " << payloads->bytes()
+                << " of " << payloads->internedBytes() << std::endl;
+        }
+
+        if (options.connection_pool_) {
+            std::cerr << "connections opened: " << options.connection_pool_->connects() << ", reused: " << options.connection_pool_->reuses() << std::endl;
+        }
+
+        if (options.tls_context_) {
+            std::cerr << "TLS handshakes: " << options.tls_context_->handshakes() << ", resumed: " << options.tls_context_->resumed()
+                << ", kernel TLS: " << options.tls_context_->ktls() << std::endl;
         }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
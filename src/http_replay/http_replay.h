@@ -1,26 +1,172 @@
 #ifndef PACKET_REPLAY_REST_CLIENT_H
 #define PACKET_REPLAY_REST_CLIENT_H
 
+#include <unistd.h>
+
+#include <sys/uio.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "action.h"
+#include "action_template.h"
 #include "capture.h"
+#include "connection.h"
+#include "connection_pool.h"
+#include "header_rules.h"
+#include "http_response_processor.h"
+#include "json_comparator.h"
 #include "tcp_conversation.h"
+#include "tls_context.h"
+#include "validation_pipeline.h"
 
 namespace packet_replay {
+    /**
+     * Options that control how conversations are replayed and how responses are validated
+     */
+    class HttpReplayOptions {
+        public:
+            // compare JSON response bodies for equivalence instead of byte by byte when set
+            std::unique_ptr<JsonComparator> json_comparator_;
+
+            // validate response headers with these rules when set
+            std::unique_ptr<HeaderRules> header_rules_;
+
+            // the maximum number of requests sent before waiting for a response
+            int pipeline_depth_ = 1;
+
+            // the maximum number of open HTTP/2 streams, the server's SETTINGS_MAX_CONCURRENT_STREAMS when 0
+            int max_streams_ = 0;
+
+            // connect to test servers with TLS when set.  declared before the pool so it outlives pooled connections
+            std::unique_ptr<TlsContext> tls_context_;
+
+            // reuse keep-alive connections across conversations to the same server when set
+            std::unique_ptr<ConnectionPool> connection_pool_;
+
+            // replay the requests of all conversations to the same server as streams of one HTTP/2 connection
+            bool http2_ = false;
+
+            // the values the variables of script actions start with in each replay
+            VariableTable variables_;
+
+            // compare HTTP/1.x responses on these threads instead of the replay thread when set.  declared last so the
+            // threads stop before the comparators they use are destroyed
+            std::unique_ptr<ValidationPipeline> validation_pipeline_;
+    };
+
+    /**
+     * A received response and its expected response compared on a validation thread
+     */
+    class HttpValidationJob : public ValidationJob {
+        public:
+            std::unique_ptr<HttpResponseProcessor> expected_;
+            std::unique_ptr<HttpResponseProcessor> actual_;
+            bool different_ = false;
+
+            // set when the captured response is incomplete, the response is read but not compared
+            bool incomplete_ = false;
+
+            // the processors are returned here after the report so their buffers are reused
+            std::vector<std::unique_ptr<HttpResponseProcessor>>& spare_;
+
+            HttpValidationJob(std::unique_ptr<HttpResponseProcessor> expected, std::unique_ptr<HttpResponseProcessor> actual,
+                std::vector<std::unique_ptr<HttpResponseProcessor>>& spare) :
+                expected_(std::move(expected)), actual_(std::move(actual)), spare_(spare) {
+            }
+
+            void validate(PacketValidator* validator) override;
+            void report() override;
+    };
+
     /**
      * A HTTP client used to replay a conversation
      */
     class HttpReplayClient {
         private:
+            constexpr static int RECV_BUF_SIZE = 64 * 1024;
+
             TcpConversation* conversation_;
-            int socket_;
+            const HttpReplayOptions& options_;
+            std::unique_ptr<Connection> connection_;
+
+            // data read from the socket.  bytes between recv_start_ and recv_end_ have not been consumed by a response yet
+            std::unique_ptr<uint8_t[]> recv_buf_;
+            int recv_start_ = 0;
+            int recv_end_ = 0;
+
+            // expected responses for requests that were sent but whose response has not been read yet
+            std::deque<std::unique_ptr<HttpResponseProcessor>> pending_;
+
+            // the expected response being assembled from the captured data
+            std::unique_ptr<HttpResponseProcessor> expected_;
+
+            // set when a request is sent while expected_ is incomplete.  the next captured data either continues the
+            // response, e.g. in a pipelined capture, or starts with a status line, showing the response was cut short
+            bool interrupted_ = false;
+
+            // whether expected_ starts with a status line, rather than with stray bytes following a captured response
+            bool expected_response_ = false;
+
+            // processors of compared responses, reused so that their buffers and decoders are allocated once
+            std::vector<std::unique_ptr<HttpResponseProcessor>> spare_;
+
+            HttpResponseProcessor test_processor_;
+
+            // false once a response on the current connection did not allow the connection to be kept open
+            bool keep_alive_ = true;
+
+            // the values of the variables of this replay, and the pieces and computed Content-Length of the last action
+            // with variables
+            VariableTable variables_;
+            std::vector<struct iovec> iov_;
+            std::string content_length_;
+
+            // the number of expected responses with extraction rules that have not been read yet
+            int pending_extractions_ = 0;
+
+            // set when responses are compared asynchronously.  declared after spare_ since its jobs return processors
+            // there
+            std::unique_ptr<ValidationQueue> validation_queue_;
 
             HttpReplayClient(const HttpReplayClient&) = delete;
             HttpReplayClient& operator=(const HttpReplayClient&) = delete;
             HttpReplayClient() = delete;
 
+            std::unique_ptr<HttpResponseProcessor> createProcessor();
+            void processExpectedData(const uint8_t* data, int data_len);
+            void endExpected();
+            void receiveResponse();
+            void extract(const std::vector<ExtractionRule>& rules, const HttpResponseProcessor& response);
+            void closeConnection();
+
         public:
-            HttpReplayClient(TcpConversation* conversation) : conversation_(conversation), socket_(-1) {
+            HttpReplayClient(TcpConversation* conversation, const HttpReplayOptions& options) : 
+                conversation_(conversation), options_(options), recv_buf_(new uint8_t[RECV_BUF_SIZE]), variables_(options.variables_) {
+                test_processor_.setHeaderRules(options.header_rules_.get());
+
+                if (options.validation_pipeline_) {
+                    validation_queue_.reset(new ValidationQueue(*options.validation_pipeline_, options.validation_pipeline_->capacity()));
+                }
             }
-            
+
+            /**
+             * The variables of this replay, initialized from the options.  May be changed before replay, e.g. with
+             * values from a data file
+             */
+            VariableTable& variables() {
+                return variables_;
+            }
+
+            /**
+             * Replay the conversation.  Up to the configured pipeline depth of requests are sent before waiting for a
+             * response.  Responses are read in order from a single receive buffer, so bytes read past the end of one
+             * response are kept for the next one.  With a validation pipeline each response is handed to the
+             * validation threads and the differences are reported in response order.  The actions are not consumed,
+             * so one conversation can be replayed by several clients, also on different threads.
+             */
             void replay();
     };
 }
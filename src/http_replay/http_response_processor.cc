@@ -1,57 +1,124 @@
+#include <ctype.h>
 #include <string.h>
+#include <strings.h>
 #include <stdint.h>
 #include <stdlib.h>
 
-#include <sstream>
+#include <charconv>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 #include "http_response_processor.h"
 #include "util.h"
 
 namespace packet_replay {
+    static bool equalsIgnoreCase(std::string_view value, const char* literal) {
+        auto len = strlen(literal);
+
+        return value.size() == len && strncasecmp(value.data(), literal, len) == 0;
+    }
+
+    static std::string_view trimView(std::string_view value) {
+        while (!value.empty() && isspace(static_cast<unsigned char>(value.front()))) {
+            value.remove_prefix(1);
+        }
+
+        while (!value.empty() && isspace(static_cast<unsigned char>(value.back()))) {
+            value.remove_suffix(1);
+        }
+
+        return value;
+    }
+
     bool HttpResponseProcessor::processData(const std::vector<char>& data) {
         return processData(reinterpret_cast<const uint8_t*>(data.data()), data.size());
     }
 
     bool HttpResponseProcessor::processData(const uint8_t* data, int data_size) {
-        if (status_code_ == -1) {
-            auto orig_len = header_str_.length();
-            header_str_.append(reinterpret_cast<const char *>(data), data_size);
-
-            if (orig_len + data_size > 3) {
-                int find_start = orig_len < 3 ? 0 : orig_len - 3;
-                int pos = header_str_.find("\r\n\r\n", find_start);
-
-                if (pos != std::string::npos) {
-                    std::map<std::string, std::string>::iterator it;
-
-                    parseHeader(header_str_.substr(0, pos));
-                    if (headers_.contains("content-length")) {
-                        data_processor_.reset(new HttpResponseProcessor::ContentLenProcessor(headers_));
-                    } else if ((it = headers_.find("transfer-encoding")) != headers_.cend() && strcasecmp((*it).second.c_str(), "chunked") == 0) {
-                        data_processor_.reset(new HttpResponseProcessor::ChunkedProcessor());
-                    } else {
-                        throw std::runtime_error("unsupported HTTP encoding");
-                    }
+        consume(data, data_size);
 
-                    if (header_str_.length() > pos + 4) {
-                        int len = header_str_.length() - (pos + 4);
+        return complete();
+    }
 
-                        (*data_processor_).process(reinterpret_cast<const uint8_t *>(header_str_.substr(pos + 4).c_str()), len);
-                        header_str_.resize(pos + 4);
-                    }
-                }
-            } 
+    int HttpResponseProcessor::consume(const uint8_t* data, int data_size) {
+        if (status_code_ != -1) {
+            return (*data_processor_).process(data, data_size);
+        }
+
+        auto orig_len = header_str_.length();
+        header_str_.append(reinterpret_cast<const char *>(data), data_size);
+
+        if (orig_len + data_size <= 3) {
+            return data_size;
+        }
+
+        int find_start = orig_len < 3 ? 0 : orig_len - 3;
+        auto pos = header_str_.find("\r\n\r\n", find_start);
+
+        if (pos == std::string::npos) {
+            return data_size;
+        }
+
+        parseHeader(pos);
+
+        auto decoder = getContentDecoder();
+        decoder->reset();
+
+        auto content_length = header_values_[HeaderIndex::CONTENT_LENGTH];
+        auto transfer_encoding = header_values_[HeaderIndex::TRANSFER_ENCODING];
+
+        if (content_length.data() != nullptr) {
+            int payload_size;
+            auto result = std::from_chars(content_length.data(), content_length.data() + content_length.size(), payload_size);
+
+            if (result.ec != std::errc() || payload_size < 0) {
+                throw std::runtime_error("invalid content-length " + std::string(content_length));
+            }
+
+            data_processor_.reset(new HttpResponseProcessor::ContentLenProcessor(payload_size, decoder, body_));
+        } else if (equalsIgnoreCase(transfer_encoding, "chunked")) {
+            data_processor_.reset(new HttpResponseProcessor::ChunkedProcessor(decoder, body_));
         } else {
-            (*data_processor_).process(data, data_size);
+            throw std::runtime_error("unsupported HTTP encoding");
         }
 
-        if ((*data_processor_).isComplete()) {
-            return true;
-        } 
+        auto body_start = pos + 4;
+        int consumed = body_start - orig_len;
 
-        return false;
+        if (header_str_.length() > body_start) {
+            int len = header_str_.length() - body_start;
+
+            consumed += (*data_processor_).process(reinterpret_cast<const uint8_t *>(header_str_.data() + body_start), len);
+            header_str_.resize(body_start);
+        }
+
+        return consumed;
+    }
+
+    bool HttpResponseProcessor::keepAlive() const {
+        if (!complete()) {
+            return false;
+        }
+
+        // HTTP/1.0 responses default to closing the connection
+        bool keep_alive = header_str_.compare(0, 8, "HTTP/1.0") != 0;
+        auto connection = header_values_[HeaderIndex::CONNECTION];
+
+        while (!connection.empty()) {
+            auto comma = connection.find(',');
+            auto token = trimView(connection.substr(0, comma));
+
+            if (equalsIgnoreCase(token, "close")) {
+                return false;
+            } else if (equalsIgnoreCase(token, "keep-alive")) {
+                keep_alive = true;
+            }
+
+            connection.remove_prefix(comma == std::string_view::npos ? connection.size() : comma + 1);
+        }
+
+        return keep_alive;
     }
 
     int HttpResponseProcessor::compare(const HttpResponseProcessor& other) const {
@@ -65,82 +132,124 @@ namespace packet_replay {
             return ret;
         }
 
-        return (*data_processor_).compare(other.data_processor_.get());
+        if (header_rules_ != nullptr) {
+            if (other.header_index_ != header_index_) {
+                throw std::runtime_error("internal failure: responses processed with different header rules");
+            }
+
+            if (!header_rules_->validate(headers_, header_values_, other.headers_, other.header_values_)) {
+                return 1;
+            }
+        }
+
+        if (json_comparator_ != nullptr && isJson()) {
+            return json_comparator_->equivalent(body_.data(), body_.size(), other.body_.data(), other.body_.size()) ? 0 : 1;
+        }
+
+        int size_diff = body_.size() - other.body_.size();
+
+        if (size_diff != 0) {
+            return size_diff;
+        }
+
+        return memcmp(body_.data(), other.body_.data(), body_.size());
     }
 
-    void HttpResponseProcessor::parseHeader(const std::string& header_str) {
-        std::stringstream stream(header_str);
+    void HttpResponseProcessor::parseHeader(size_t header_len) {
+        const char* ptr = header_str_.data();
+        const char* end = ptr + header_len;
 
-        std::string token;
-        if (std::getline(stream, token, '\n')) {
-            std::stringstream status(token);
-            std::string status_token;
+        headers_.clear();
+        header_values_.assign(header_index_->size(), std::string_view());
 
-            if (std::getline(status, status_token, ' ') && std::getline(status, status_token, ' ')) {
-                status_code_ = std::stoul(status_token);
-            }
+        auto line_end = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
 
-            while (std::getline(stream, token, '\n')) {
-                std::stringstream header_stream(token);
+        // status line: <version> <status code> <reason>
+        auto status_start = static_cast<const char *>(memchr(ptr, ' ', line_end - ptr));
+        if (status_start == nullptr || std::from_chars(status_start + 1, line_end, status_code_).ec != std::errc()) {
+            throw std::runtime_error("invalid HTTP status line " + std::string(ptr, line_end - ptr));
+        }
 
-                std::string key;
-                std::string value;
+        while (line_end < end) {
+            ptr = line_end + 1;
+            line_end = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
 
-                std::getline(header_stream, key, ':');
-                std::getline(header_stream, value, '\r');
+            if (line_end == nullptr) {
+                line_end = end;
+            }
 
-                trim(key);
-                trim(value);
+            auto colon = static_cast<const char *>(memchr(ptr, ':', line_end - ptr));
+            if (colon == nullptr) {
+                continue;
+            }
 
-                toLower(key);
+            auto name = trimView(std::string_view(ptr, colon - ptr));
+            auto value = trimView(std::string_view(colon + 1, line_end - (colon + 1)));
+            auto slot = header_index_->find(name);
 
-                headers_[key] = value;
+            headers_.push_back(HttpHeader{name, value, slot});
+
+            if (slot >= 0 && header_values_[slot].data() == nullptr) {
+                header_values_[slot] = value;
             }
         }
     }
 
-    int HttpResponseProcessor::ContentLenProcessor::compare(const HttpResponseProcessor::DataProcessor* other) const {
-        const ContentLenProcessor* typed_other = dynamic_cast<const ContentLenProcessor *>(other);
-
-        if (typed_other == nullptr) {
-            throw std::runtime_error("response used different transfer encoding");
-        }
+    bool HttpResponseProcessor::isJson() const {
+        auto content_type = header_values_[HeaderIndex::CONTENT_TYPE];
 
-        if (typed_other->payload_size_ != payload_size_) {
-            return payload_size_ - typed_other->payload_size_;
+        // matches application/json as well as the structured syntax suffix, e.g. application/problem+json
+        for (size_t i = 0; i + 4 <= content_type.size(); i++) {
+            if (equalsIgnoreCase(content_type.substr(i, 4), "json")) {
+                return true;
+            }
         }
 
-        return memcmp(payload_, typed_other->payload_, payload_size_);
+        return false;
     }
 
-    int HttpResponseProcessor::ChunkedProcessor::compare(const DataProcessor* other) const {
-        auto typed_other = dynamic_cast<const ChunkedProcessor *>(other);
+    ContentDecoder* HttpResponseProcessor::getContentDecoder() {
+        auto encoding = header_values_[HeaderIndex::CONTENT_ENCODING];
 
-        if (typed_other == nullptr) {
-            throw std::runtime_error("response used different transfer encoding");
+        if (encoding.empty() || equalsIgnoreCase(encoding, "identity")) {
+            return &identity_decoder_;
         }
 
-        int size_diff = data_.size() - typed_other->data_.size();
+        if (equalsIgnoreCase(encoding, "gzip") || equalsIgnoreCase(encoding, "x-gzip") || equalsIgnoreCase(encoding, "deflate")) {
+            if (!zlib_decoder_) {
+                zlib_decoder_.reset(new ZlibDecoder());
+            }
 
-        if (size_diff != 0) {
-            return size_diff;
+            return zlib_decoder_.get();
         }
 
-        return strncmp(data_.data(),  typed_other->data_.data(), data_.size());
+        if (equalsIgnoreCase(encoding, "br")) {
+            if (!brotli_decoder_) {
+                brotli_decoder_.reset(new BrotliDecoder());
+            }
+
+            return brotli_decoder_.get();
+        }
+
+        throw std::runtime_error("unsupported content encoding " + std::string(encoding));
     }
 
-    bool HttpResponseProcessor::ChunkedProcessor::process(const uint8_t* data, int data_len) {
+    int HttpResponseProcessor::ChunkedProcessor::process(const uint8_t* data, int data_len) {
         auto nprocessed = 0;
 
         while (data_len > nprocessed) {
             if (chunk_size_ <  0) {
                 auto copy_len = (data_len - nprocessed) < (TMPSIZ - tmp_buf_size_) ? data_len - nprocessed : (TMPSIZ - tmp_buf_size_);
+                auto prev_size = tmp_buf_size_;
 
                 memcpy(tmp_buf_ + tmp_buf_size_, data + nprocessed, copy_len);
                 tmp_buf_size_ += copy_len;
                 tmp_buf_[tmp_buf_size_] = '\0';
 
-                if (strstr(tmp_buf_, "\r\n") != nullptr) {
+                if (auto crlf = strstr(tmp_buf_, "\r\n"); crlf != nullptr) {
                     char* end_ptr;
 
                     chunk_size_ = strtoul(tmp_buf_, &end_ptr, 16);
@@ -149,11 +258,12 @@ namespace packet_replay {
                         throw std::runtime_error("invalid chunk size in " + std::string(tmp_buf_));
                     }
 
-                    nprocessed += end_ptr - tmp_buf_ + 2;
+                    // only count the bytes up to the end of the size line, which may carry chunk extensions
+                    nprocessed += (crlf - tmp_buf_ + 2) - prev_size;
                 } else if (tmp_buf_size_ == TMPSIZ) {
                     throw std::runtime_error("failed to find chunk size");
                 } else {
-                    return false;
+                    return nprocessed + copy_len;
                 }
             } else if (chunk_read_ == chunk_size_) {
                 if (chunk_end_char_count_ == 0) {
@@ -161,7 +271,7 @@ namespace packet_replay {
                         chunk_end_char_count_++;
                         nprocessed++;
                     } else {
-                        throw std::runtime_error("invalid chunk terminator char " + data[nprocessed]);
+                        throw std::runtime_error("invalid chunk terminator char " + std::to_string(data[nprocessed]));
                     }
                 } else if (chunk_end_char_count_ == 1) {
                     if (data[nprocessed] == '\n') {
@@ -169,7 +279,7 @@ namespace packet_replay {
 
                         if (chunk_size_ == 0) {
                             complete_ = true;
-                            return true;
+                            return nprocessed;
                         }
 
                         // reset for new chunk
@@ -178,19 +288,19 @@ namespace packet_replay {
                         tmp_buf_size_ = 0;
                         chunk_end_char_count_ = 0;
                     } else {
-                        throw std::runtime_error("invalid chunk terminator char " + data[nprocessed]);
+                        throw std::runtime_error("invalid chunk terminator char " + std::to_string(data[nprocessed]));
                     }
                 }
             } else {
                 auto copy_len = (data_len - nprocessed) < (chunk_size_ - chunk_read_) ? data_len - nprocessed : chunk_size_ - chunk_read_;
 
-                data_.insert(data_.cend(), (char *) data + nprocessed, (char *) data + nprocessed + copy_len);
+                decoder_->decode(data + nprocessed, copy_len, body_);
                 chunk_read_ += copy_len;
                 nprocessed += copy_len;
             }
         }
 
-        return false;
+        return nprocessed;
     }
 
 }
\ No newline at end of file
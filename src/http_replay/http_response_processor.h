@@ -1,12 +1,17 @@
 #ifndef PACKET_REPLAY_HTTP_RESPONSE_PROCESSOR_H
 #define PACKET_REPLAY_HTTP_RESPONSE_PROCESSOR_H
 
-#include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdint.h>
 
+#include "content_decoder.h"
+#include "extraction_rule.h"
+#include "header_rules.h"
+#include "json_comparator.h"
+
 namespace packet_replay {
     /**
      * Class to interpret a HTTP response.
@@ -15,19 +20,26 @@ namespace packet_replay {
     {
         private:
             /**
-             * Class to handle the payload portion of the HTTP response
+             * Class to handle the payload portion of the HTTP response.  The payload is passed to the content decoder
+             * with the transfer encoding removed.
              */
             class DataProcessor {
+                protected:
+                    ContentDecoder* decoder_;
+                    std::vector<char>& body_;
+
+                    DataProcessor(ContentDecoder* decoder, std::vector<char>& body) : decoder_(decoder), body_(body) {
+                    }
+
                 public:
-                    /** 
-                     * Compare if the specified datga processor contains the same data 
-                    */
-                    virtual int compare(const DataProcessor* other) const = 0;
+                    virtual ~DataProcessor() {}
 
                     /**
-                     * Process incoming data for the response
+                     * Process incoming data for the response.  Processing stops at the end of the payload.
+                     *
+                     * @return the number of bytes consumed
                      */
-                    virtual bool process(const uint8_t* data, int data_len) = 0;
+                    virtual int process(const uint8_t* data, int data_len) = 0;
 
                     /**
                      * Flags whether this response payload has been fully processed.
@@ -39,27 +51,21 @@ namespace packet_replay {
              * DataProcessor for responses that specify "content-length"
              */
             class ContentLenProcessor : public DataProcessor {
-                uint8_t* payload_;
                 int payload_size_;
                 int payload_read_ = 0;
-    
-                public:
-                    ContentLenProcessor(std::map<std::string, std::string> headers) {
-                        payload_size_ = std::stoul(headers["content-length"]);
-                        payload_ = new uint8_t[payload_size_];
-                    }
 
-                    ~ContentLenProcessor() {
-                        delete[] payload_;
+                public:
+                    ContentLenProcessor(int payload_size, ContentDecoder* decoder, std::vector<char>& body) :
+                        DataProcessor(decoder, body), payload_size_(payload_size) {
                     }
 
-                    int compare(const DataProcessor* other) const override;
+                    int process(const uint8_t* data, int data_len) override {
+                        auto len = data_len < payload_size_ - payload_read_ ? data_len : payload_size_ - payload_read_;
 
-                    bool process(const uint8_t* data, int data_len) override {
-                        memcpy(payload_ + payload_read_, data, data_len);
-                        payload_read_ += data_len;
+                        decoder_->decode(data, len, body_);
+                        payload_read_ += len;
 
-                        return isComplete();
+                        return len;
                     }
 
                     bool isComplete() const override {
@@ -77,24 +83,43 @@ namespace packet_replay {
                 int tmp_buf_size_ = 0;
                 int chunk_end_char_count_ = 0;
                 char tmp_buf_[TMPSIZ + 1];
-                std::vector<char> data_;
                 bool complete_ = false;
 
                 public:
-                    int compare(const DataProcessor* other) const override;
-                    bool process(const uint8_t* data, int data_len) override;
+                    ChunkedProcessor(ContentDecoder* decoder, std::vector<char>& body) : DataProcessor(decoder, body) {
+                    }
+
+                    int process(const uint8_t* data, int data_len) override;
                     bool isComplete() const override {
                         return complete_;
                     }
             };
 
             std::string header_str_;
-            std::map<std::string, std::string> headers_;
             int status_code_;
 
+            // headers in the order received and the values of the indexed headers by slot, both pointing into header_str_
+            std::vector<HttpHeader> headers_;
+            std::vector<std::string_view> header_values_;
+            const HeaderIndex* header_index_ = &HeaderIndex::defaultIndex();
+            const HeaderRules* header_rules_ = nullptr;
+
             std::unique_ptr<DataProcessor> data_processor_;
 
-            void parseHeader(const std::string& header_str);
+            // decoded response body.  cleared but not freed on reset so the buffer is reused by later responses
+            std::vector<char> body_;
+
+            // content decoders are created on first use and kept for the lifetime of the processor
+            IdentityDecoder identity_decoder_;
+            std::unique_ptr<ZlibDecoder> zlib_decoder_;
+            std::unique_ptr<BrotliDecoder> brotli_decoder_;
+
+            const JsonComparator* json_comparator_ = nullptr;
+            const std::vector<ExtractionRule>* extraction_rules_ = nullptr;
+
+            void parseHeader(size_t header_len);
+            ContentDecoder* getContentDecoder();
+            bool isJson() const;
 
         public:
             HttpResponseProcessor() {
@@ -102,29 +127,97 @@ namespace packet_replay {
             }
 
             /**
-             * Consume the response data.
+             * Consume the response data.  Data past the end of the response is ignored.
+             *
+             * @return whether the response is complete
              */
             bool processData(const std::vector<char>& data);
             bool processData(const uint8_t* data, int data_len);
 
+            /**
+             * Consume the response data up to the end of the response.
+             *
+             * @return the number of bytes consumed.  Any remaining bytes belong to the next response.
+             */
+            int consume(const uint8_t* data, int data_len);
+
             /**
              * Reset this class to consume a new HTTP response
              */
-            void reset() {        
+            void reset() {
                 status_code_ = -1;
                 header_str_.resize(0);
+                headers_.clear();
+                header_values_.clear();
+                body_.clear();
                 data_processor_.reset(nullptr);
+                extraction_rules_ = nullptr;
             }
 
             /**
              * Whether all data from the response has been consumed.
              */
             bool complete() const {
-                return status_code_ != -1 && (*data_processor_).isComplete();
+                return data_processor_ && (*data_processor_).isComplete();
             }
 
+            /**
+             * Whether the server keeps the connection open after this response.  HTTP/1.1 connections are persistent
+             * unless the response has "Connection: close", HTTP/1.0 connections only with "Connection: keep-alive".
+             */
+            bool keepAlive() const;
+
+            /**
+             * The status line and headers as received
+             */
+            std::string_view header() const {
+                return header_str_;
+            }
+
+            /**
+             * The response body with any content encoding removed.
+             */
+            const std::vector<char>& body() const {
+                return body_;
+            }
+
+            /**
+             * Compare JSON bodies of responses processed by this object with the specified comparator instead of byte
+             * by byte.  The comparator is not owned by this object and is kept across calls to reset.
+             */
+            void setJsonComparator(const JsonComparator* json_comparator) {
+                json_comparator_ = json_comparator;
+            }
+
+            /**
+             * Validate the headers of responses processed by this object with the specified rules.  Both responses
+             * being compared must use the same rules.  The rules are not owned by this object and are kept across
+             * calls to reset.
+             */
+            void setHeaderRules(const HeaderRules* header_rules) {
+                header_rules_ = header_rules;
+                header_index_ = header_rules != nullptr ? &header_rules->getIndex() : &HeaderIndex::defaultIndex();
+            }
+
+            /**
+             * The rules extracting variables from the response matched with this response, treated as the expected
+             * response.  The rules are not owned by this object and are cleared by reset.
+             */
+            void setExtractionRules(const std::vector<ExtractionRule>* extraction_rules) {
+                extraction_rules_ = extraction_rules;
+            }
+
+            const std::vector<ExtractionRule>* getExtractionRules() const {
+                return extraction_rules_;
+            }
+
+            /**
+             * Compare this response, treated as the expected response, with the specified response.
+             *
+             * @return 0 if the responses are equivalent
+             */
             int compare(const HttpResponseProcessor& other) const;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,464 @@
+#include <ctype.h>
+#include <string.h>
+
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "json_comparator.h"
+#include "util.h"
+
+namespace packet_replay {
+    static const uint64_t NULL_TAG = 0x6e756c6cULL;
+    static const uint64_t TRUE_TAG = 0x74727565ULL;
+    static const uint64_t FALSE_TAG = 0x66616c73ULL;
+    static const uint64_t NUMBER_TAG = 0x6e756d62ULL;
+    static const uint64_t STRING_TAG = 0x73747269ULL;
+    static const uint64_t ARRAY_TAG = 0x61727261ULL;
+    static const uint64_t OBJECT_TAG = 0x6f626a65ULL;
+
+    static const int MAX_DEPTH = 512;
+
+    // integers from 2^53 on are no longer exactly representable as a double
+    static const double EXACT_INTEGER_LIMIT = 9007199254740992.0;
+
+    // path segment used for array elements; only matched by the wildcard
+    static const std::string_view ARRAY_SEGMENT = "[]";
+
+    static inline uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static inline uint64_t combine(uint64_t h, uint64_t value) {
+        return mix(h ^ (value + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+    }
+
+    static uint64_t hashBytes(const char* data, size_t len) {
+        uint64_t h = 0xcbf29ce484222325ULL ^ len;
+
+        while (len >= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            h = combine(h, word);
+            data += 8;
+            len -= 8;
+        }
+
+        if (len > 0) {
+            uint64_t word = 0;
+            memcpy(&word, data, len);
+            h = combine(h, word);
+        }
+
+        return h;
+    }
+
+    /**
+     * Single pass recursive descent over a JSON document producing its canonical hash
+     */
+    class JsonHasher {
+        private:
+            const JsonComparator& comparator_;
+            const char* ptr_;
+            const char* end_;
+            int depth_ = 0;
+            std::vector<std::string_view> path_;
+
+            [[noreturn]] void fail(const char* reason) {
+                throw std::runtime_error(std::string("invalid JSON: ") + reason);
+            }
+
+            void skipWhitespace() {
+#if defined(__SSE2__)
+                // pretty printed documents have long runs of indentation, skip them 16 bytes at a time
+                while (end_ - ptr_ >= 16 && (*ptr_ == ' ' || *ptr_ == '\n' || *ptr_ == '\r' || *ptr_ == '\t')) {
+                    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr_));
+                    __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))),
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))));
+                    unsigned mask = ~_mm_movemask_epi8(ws) & 0xffff;
+
+                    if (mask != 0) {
+                        ptr_ += __builtin_ctz(mask);
+                        return;
+                    }
+
+                    ptr_ += 16;
+                }
+#endif
+                while (ptr_ < end_ && (*ptr_ == ' ' || *ptr_ == '\n' || *ptr_ == '\r' || *ptr_ == '\t')) {
+                    ptr_++;
+                }
+            }
+
+            /**
+             * Scan a string starting after the opening quote.  Returns the raw contents and leaves the position after
+             * the closing quote.
+             */
+            std::string_view scanString() {
+                const char* start = ptr_;
+
+                while (true) {
+#if defined(__SSE2__)
+                    while (end_ - ptr_ >= 16) {
+                        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr_));
+                        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+                        unsigned mask = _mm_movemask_epi8(special);
+
+                        if (mask != 0) {
+                            ptr_ += __builtin_ctz(mask);
+                            break;
+                        }
+
+                        ptr_ += 16;
+                    }
+#endif
+                    while (ptr_ < end_ && *ptr_ != '"' && *ptr_ != '\\') {
+                        ptr_++;
+                    }
+
+                    if (ptr_ >= end_) {
+                        fail("unterminated string");
+                    }
+
+                    if (*ptr_ == '"') {
+                        std::string_view str(start, ptr_ - start);
+                        ptr_++;
+                        return str;
+                    }
+
+                    // skip the escaped character
+                    ptr_ += 2;
+                }
+            }
+
+            bool isIgnored() const {
+                for (auto& ignored_path : comparator_.ignored_paths_) {
+                    if (ignored_path.size() != path_.size()) {
+                        continue;
+                    }
+
+                    bool match = true;
+
+                    for (size_t i = 0; i < path_.size(); i++) {
+                        if (ignored_path[i] != JsonComparator::WILDCARD && ignored_path[i] != path_[i]) {
+                            match = false;
+                            break;
+                        }
+                    }
+
+                    if (match) {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            bool trackPath() const {
+                return depth_ <= static_cast<int>(comparator_.max_ignored_depth_);
+            }
+
+            void expectLiteral(const char* literal, size_t len) {
+                if (static_cast<size_t>(end_ - ptr_) < len || memcmp(ptr_, literal, len) != 0) {
+                    fail("unexpected token");
+                }
+
+                ptr_ += len;
+            }
+
+            uint64_t number() {
+                const char* start = ptr_;
+                bool integer = true;
+
+                while (ptr_ < end_ && (isdigit(static_cast<unsigned char>(*ptr_)) || *ptr_ == '-' || *ptr_ == '+' || *ptr_ == '.' || *ptr_ == 'e' || *ptr_ == 'E')) {
+                    integer = integer && *ptr_ != '.' && *ptr_ != 'e' && *ptr_ != 'E';
+                    ptr_++;
+                }
+
+                double value;
+                auto result = std::from_chars(start, ptr_, value);
+
+                if (result.ec == std::errc::invalid_argument || result.ptr != ptr_) {
+                    fail("invalid number");
+                }
+
+                if (integer && (result.ec == std::errc::result_out_of_range || value >= EXACT_INTEGER_LIMIT || value <= -EXACT_INTEGER_LIMIT)) {
+                    // a double can't tell large integers such as 64 bit ids apart, hash their digits instead
+                    const char* digits = start;
+                    bool negative = *digits == '-';
+
+                    if (negative) {
+                        digits++;
+                    }
+
+                    while (ptr_ - digits > 1 && *digits == '0') {
+                        digits++;
+                    }
+
+                    return combine(combine(NUMBER_TAG, negative), hashBytes(digits, ptr_ - digits));
+                }
+
+                if (result.ec == std::errc::result_out_of_range) {
+                    return combine(NUMBER_TAG, hashBytes(start, ptr_ - start));
+                }
+
+                if (value == 0) {
+                    // -0 and 0 are the same number
+                    value = 0;
+                }
+
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+
+                return combine(NUMBER_TAG, bits);
+            }
+
+            uint64_t array() {
+                uint64_t h = ARRAY_TAG;
+                uint64_t count = 0;
+
+                skipWhitespace();
+
+                if (ptr_ < end_ && *ptr_ == ']') {
+                    ptr_++;
+                    return combine(h, count);
+                }
+
+                while (true) {
+                    bool tracked = trackPath();
+
+                    if (tracked) {
+                        path_.push_back(ARRAY_SEGMENT);
+                    }
+
+                    if (tracked && isIgnored()) {
+                        skipValue();
+                    } else {
+                        h = combine(h, value());
+                        count++;
+                    }
+
+                    if (tracked) {
+                        path_.pop_back();
+                    }
+
+                    skipWhitespace();
+
+                    if (ptr_ >= end_) {
+                        fail("unterminated array");
+                    }
+
+                    if (*ptr_ == ']') {
+                        ptr_++;
+                        return combine(h, count);
+                    }
+
+                    if (*ptr_ != ',') {
+                        fail("expected ',' in array");
+                    }
+
+                    ptr_++;
+                }
+            }
+
+            uint64_t object() {
+                // members are summed so that the result does not depend on their order
+                uint64_t sum = 0;
+                uint64_t count = 0;
+
+                skipWhitespace();
+
+                if (ptr_ < end_ && *ptr_ == '}') {
+                    ptr_++;
+                    return combine(OBJECT_TAG, 0);
+                }
+
+                while (true) {
+                    skipWhitespace();
+
+                    if (ptr_ >= end_ || *ptr_ != '"') {
+                        fail("expected object key");
+                    }
+
+                    ptr_++;
+                    auto key = scanString();
+
+                    skipWhitespace();
+
+                    if (ptr_ >= end_ || *ptr_ != ':') {
+                        fail("expected ':' in object");
+                    }
+
+                    ptr_++;
+
+                    bool tracked = trackPath();
+
+                    if (tracked) {
+                        path_.push_back(key);
+                    }
+
+                    if (tracked && isIgnored()) {
+                        skipValue();
+                    } else {
+                        sum += combine(hashBytes(key.data(), key.size()), value());
+                        count++;
+                    }
+
+                    if (tracked) {
+                        path_.pop_back();
+                    }
+
+                    skipWhitespace();
+
+                    if (ptr_ >= end_) {
+                        fail("unterminated object");
+                    }
+
+                    if (*ptr_ == '}') {
+                        ptr_++;
+                        return combine(combine(OBJECT_TAG, count), sum);
+                    }
+
+                    if (*ptr_ != ',') {
+                        fail("expected ',' in object");
+                    }
+
+                    ptr_++;
+                }
+            }
+
+            void skipValue() {
+                // ignored values still have to be valid JSON, hashing them is the simplest way to walk over them
+                value();
+            }
+
+        public:
+            JsonHasher(const JsonComparator& comparator, const char* data, size_t data_len) :
+                comparator_(comparator), ptr_(data), end_(data + data_len) {
+                path_.reserve(comparator.max_ignored_depth_ + 1);
+            }
+
+            uint64_t value() {
+                skipWhitespace();
+
+                if (ptr_ >= end_) {
+                    fail("unexpected end of document");
+                }
+
+                uint64_t h;
+
+                switch (*ptr_) {
+                    case '{':
+                        if (++depth_ > MAX_DEPTH) {
+                            fail("document nested too deeply");
+                        }
+                        ptr_++;
+                        h = object();
+                        depth_--;
+                        break;
+
+                    case '[':
+                        if (++depth_ > MAX_DEPTH) {
+                            fail("document nested too deeply");
+                        }
+                        ptr_++;
+                        h = array();
+                        depth_--;
+                        break;
+
+                    case '"': {
+                        ptr_++;
+                        auto str = scanString();
+                        h = combine(STRING_TAG, hashBytes(str.data(), str.size()));
+                        break;
+                    }
+
+                    case 't':
+                        expectLiteral("true", 4);
+                        h = TRUE_TAG;
+                        break;
+
+                    case 'f':
+                        expectLiteral("false", 5);
+                        h = FALSE_TAG;
+                        break;
+
+                    case 'n':
+                        expectLiteral("null", 4);
+                        h = NULL_TAG;
+                        break;
+
+                    default:
+                        h = number();
+                        break;
+                }
+
+                return h;
+            }
+
+            uint64_t document() {
+                auto h = value();
+
+                skipWhitespace();
+
+                if (ptr_ != end_) {
+                    fail("trailing data after document");
+                }
+
+                return h;
+            }
+    };
+
+    void JsonComparator::addIgnoredPath(const std::string& path) {
+        std::vector<std::string> segments;
+        size_t start = 0;
+
+        while (true) {
+            auto end = path.find('.', start);
+            std::string segment = path.substr(start, end == std::string::npos ? std::string::npos : end - start);
+
+            trim(segment);
+
+            if (segment.empty()) {
+                throw std::invalid_argument("invalid JSON path '" + path + "'");
+            }
+
+            segments.push_back(segment);
+
+            if (end == std::string::npos) {
+                break;
+            }
+
+            start = end + 1;
+        }
+
+        if (segments.size() > max_ignored_depth_) {
+            max_ignored_depth_ = segments.size();
+        }
+
+        ignored_paths_.push_back(std::move(segments));
+    }
+
+    uint64_t JsonComparator::hash(const char* data, size_t data_len) const {
+        return JsonHasher(*this, data, data_len).document();
+    }
+
+    bool JsonComparator::equivalent(const char* expected, size_t expected_len, const char* actual, size_t actual_len) const {
+        try {
+            return hash(expected, expected_len) == hash(actual, actual_len);
+        } catch (const std::runtime_error& e) {
+            return expected_len == actual_len && memcmp(expected, actual, expected_len) == 0;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef PACKET_REPLAY_JSON_COMPARATOR_H
+#define PACKET_REPLAY_JSON_COMPARATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace packet_replay {
+    /**
+     * Compares JSON documents for equivalence.  Documents are equivalent if they only differ in whitespace, the order
+     * of object members or members at ignored paths.
+     *
+     * Documents are not parsed into a tree.  Each document is reduced to a canonical 64 bit hash in a single pass,
+     * where object members are combined order independently, and the hashes are compared.  Strings and keys are
+     * compared in their escaped form, so a character and its \u escape are considered different.  Numbers are compared
+     * by value, except integers too large for a double to hold exactly, which are compared by their digits.
+     */
+    class JsonComparator {
+        private:
+            // segment that matches any object member or array element in an ignored path
+            static constexpr std::string_view WILDCARD = "*";
+
+            std::vector<std::vector<std::string>> ignored_paths_;
+            size_t max_ignored_depth_ = 0;
+
+        public:
+            /**
+             * Ignore the members at the specified path.  The path is a list of member names separated by '.', where
+             * '*' matches any member name or array element.  Example: "data.*.updated_at"
+             */
+            void addIgnoredPath(const std::string& path);
+
+            /**
+             * Compute the canonical hash of a JSON document.  Throws std::runtime_error if the document is not valid JSON.
+             */
+            uint64_t hash(const char* data, size_t data_len) const;
+
+            /**
+             * @return true if the documents are equivalent.  If either document is not valid JSON, the documents
+             *         are compared byte by byte.
+             */
+            bool equivalent(const char* expected, size_t expected_len, const char* actual, size_t actual_len) const;
+
+        friend class JsonHasher;
+    };
+}
+
+#endif
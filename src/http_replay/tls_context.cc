@@ -0,0 +1,130 @@
+#include <stdexcept>
+#include <string>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "tls_context.h"
+
+namespace packet_replay {
+    static const unsigned char ALPN_HTTP1[] = { 8, 'h', 't', 't', 'p', '/', '1', '.', '1' };
+    static const unsigned char ALPN_HTTP2[] = { 2, 'h', '2' };
+
+    typedef std::pair<const std::string, SSL_SESSION*> SessionEntry;
+
+    static std::string sslError() {
+        char buf[256];
+        ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+
+        return buf;
+    }
+
+    TlsContext::TlsContext(const std::string& server_name, bool http2) : server_name_(server_name) {
+        ctx_ = SSL_CTX_new(TLS_client_method());
+        if (ctx_ == nullptr) {
+            throw std::runtime_error("SSL_CTX_new failed: " + sslError());
+        }
+
+        SSL_CTX_set_verify(ctx_, SSL_VERIFY_NONE, nullptr);
+
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        // a server closing the connection without close_notify is treated as a normal close
+        SSL_CTX_set_options(ctx_, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS);
+#endif
+
+        // sessions are kept per server by this class, OpenSSL only reports them
+        SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx_, onNewSession);
+        SSL_CTX_set_app_data(ctx_, this);
+
+        if (http2) {
+            SSL_CTX_set_alpn_protos(ctx_, ALPN_HTTP2, sizeof(ALPN_HTTP2));
+        } else {
+            SSL_CTX_set_alpn_protos(ctx_, ALPN_HTTP1, sizeof(ALPN_HTTP1));
+        }
+    }
+
+    TlsContext::~TlsContext() {
+        for (auto& entry : sessions_) {
+            if (entry.second != nullptr) {
+                SSL_SESSION_free(entry.second);
+            }
+        }
+
+        SSL_CTX_free(ctx_);
+    }
+
+    int TlsContext::onNewSession(SSL* ssl, SSL_SESSION* session) {
+        auto entry = static_cast<SessionEntry *>(SSL_get_app_data(ssl));
+
+        if (entry == nullptr) {
+            return 0;
+        }
+
+        // tickets arrive after the handshake, while the connection is used by its replay thread
+        auto context = static_cast<TlsContext *>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        std::lock_guard<std::mutex> lock(context->mutex_);
+
+        if (entry->second != nullptr) {
+            SSL_SESSION_free(entry->second);
+        }
+
+        // keeping the reference passed in
+        entry->second = session;
+
+        return 1;
+    }
+
+    SSL* TlsContext::handshake(int socket, const void* sock_addr, int sock_addr_size) {
+        auto ssl = SSL_new(ctx_);
+        if (ssl == nullptr) {
+            throw std::runtime_error("SSL_new failed: " + sslError());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            // map nodes are never moved, so the entry can be referenced by the connection until it is closed
+            auto& entry = *sessions_.try_emplace(std::string(static_cast<const char *>(sock_addr), sock_addr_size), nullptr).first;
+
+            SSL_set_app_data(ssl, &entry);
+
+            // takes a reference, so the session stays valid if another connection replaces it
+            if (entry.second != nullptr) {
+                SSL_set_session(ssl, entry.second);
+            }
+        }
+
+        SSL_set_fd(ssl, socket);
+
+        if (!server_name_.empty()) {
+            SSL_set_tlsext_host_name(ssl, server_name_.c_str());
+        }
+
+        if (auto ret = SSL_connect(ssl); ret != 1) {
+            auto err = SSL_get_error(ssl, ret);
+            SSL_free(ssl);
+            throw std::runtime_error("TLS handshake failed: " + sslError() + " (" + std::to_string(err) + ")");
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        handshakes_++;
+
+        if (SSL_session_reused(ssl)) {
+            resumed_++;
+        }
+
+#ifdef BIO_get_ktls_send
+        if (BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+            ktls_++;
+        }
+#endif
+
+        return ssl;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef PACKET_REPLAY_TLS_CONTEXT_H
+#define PACKET_REPLAY_TLS_CONTEXT_H
+
+#include <stddef.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_session_st SSL_SESSION;
+
+namespace packet_replay {
+    /**
+     * TLS client configuration shared by all connections to test servers.
+     *
+     * The last session ticket received from each server is kept and offered on the next connection to the same
+     * server, so repeated connections use an abbreviated handshake.  Kernel TLS is requested for every connection and
+     * used when both the kernel and OpenSSL support it for the negotiated cipher, moving record encryption into the
+     * kernel.
+     *
+     * Test servers are usually run locally with self-signed certificates, so server certificates are not verified.
+     * The context may be shared by replay threads.
+     */
+    class TlsContext {
+        private:
+            SSL_CTX* ctx_;
+            std::string server_name_;
+
+            // socket address of the server to its most recent session
+            std::unordered_map<std::string, SSL_SESSION*> sessions_;
+
+            // guards the sessions and the counters
+            std::mutex mutex_;
+
+            size_t handshakes_ = 0;
+            size_t resumed_ = 0;
+            size_t ktls_ = 0;
+
+            TlsContext(const TlsContext&) = delete;
+            TlsContext& operator=(const TlsContext&) = delete;
+
+            static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+        public:
+            /**
+             * @param server_name the name sent in the server name indication extension or empty for none
+             * @param http2 offer HTTP/2 with ALPN instead of HTTP/1.1
+             */
+            TlsContext(const std::string& server_name, bool http2);
+            ~TlsContext();
+
+            /**
+             * Perform the TLS handshake over a connected socket.  Throws std::runtime_error on failure.
+             *
+             * @return the TLS state for the connection, owned by the caller
+             */
+            SSL* handshake(int socket, const void* sock_addr, int sock_addr_size);
+
+            size_t handshakes() const {
+                return handshakes_;
+            }
+
+            size_t resumed() const {
+                return resumed_;
+            }
+
+            size_t ktls() const {
+                return ktls_;
+            }
+    };
+}
+
+#endif
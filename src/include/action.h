@@ -4,6 +4,9 @@
 #include <memory>
 #include <vector>
 
+#include "action_template.h"
+#include "extraction_rule.h"
+
 namespace packet_replay
 {
     /**
@@ -18,47 +21,12 @@ namespace packet_replay
                 CLOSE
             };
 
-            class SubToken {
-                public:
-                    SubToken(const std::string&& token, int begin_idx, int end_idx) : 
-                        token_(token), begin_idx_(begin_idx), end_idx_(end_idx) {
-                    }
-
-                    const std::string& get_token() const {
-                        return token_;
-                    }
-
-                    int get_begin() const {
-                        return begin_idx_;
-                    }
-
-                    int get_end() const {
-                        return end_idx_;
-                    }
-
-                protected:
-                    SubToken() = default;
-                    std::string token_;
-                    int begin_idx_;
-                    int end_idx_;
-            };
-
-
-            class OffsettedSubToken : public SubToken {
-                public:
-                    OffsettedSubToken(const SubToken* orig, int offset) {
-                        token_ = orig->get_token();
-                        begin_idx_ = orig->get_begin() + offset;
-                        end_idx_ = orig->get_end() + offset;
-                    }
-            };
-
             const Type type_;
 
             Action(Type type) : type_(type) {
             }
 
-            Action(Type type, std::vector<char>&& data) : type_(type), data_(data) {
+            Action(Type type, std::vector<char>&& data) : type_(type), data_(std::move(data)) {
             }
             
             Action(Type type, const char* data, int data_len) : type_(type) {
@@ -67,17 +35,69 @@ namespace packet_replay
 
             Action() = default;
 
-            void addSubToken(const std::string_view& token, int begin_idx, int end_idx) {
-                subTokens_.push_back(make_unique<SubToken>(std::string(token), begin_idx, end_idx));
+            const std::vector<char>& data() const {
+                return shared_data_ ? *shared_data_ : data_;
             }
 
-            const std::vector<char>& data() const {
+            /**
+             * The data for modification before it is sent, e.g. to rewrite a transaction ID.  Shared data is copied
+             * first, the other actions sharing it keep the original.  Must not be called while a template is set.
+             */
+            std::vector<char>& mutableData() {
+                if (shared_data_) {
+                    data_ = *shared_data_;
+                    shared_data_.reset();
+                }
+
                 return data_;
             }
 
+            /**
+             * Replace the data with an equal payload shared with other actions, see PayloadStore
+             */
+            void setSharedData(std::shared_ptr<const std::vector<char>> data) {
+                shared_data_ = std::move(data);
+                std::vector<char>().swap(data_);
+            }
+
+            bool hasSharedData() const {
+                return shared_data_ != nullptr;
+            }
+
+            /**
+             * The compiled variable references of the data, null if it has none.  The template points into the data,
+             * which must not be resized while it is set.
+             */
+            const ActionTemplate* getTemplate() const {
+                return template_.get();
+            }
+
+            ActionTemplate* getTemplate() {
+                return template_.get();
+            }
+
+            void setTemplate(std::unique_ptr<ActionTemplate> action_template) {
+                template_ = std::move(action_template);
+            }
+
+            /**
+             * The rules extracting variables from the data received in place of the data of this RECV action
+             */
+            const std::vector<ExtractionRule>& getExtractionRules() const {
+                return extraction_rules_;
+            }
+
+            void addExtractionRule(ExtractionRule&& rule) {
+                extraction_rules_.push_back(std::move(rule));
+            }
+
         private:
             std::vector<char> data_;
-            std::vector<std::unique_ptr<SubToken>> subTokens_;
+
+            // set instead of data_ if the data is shared
+            std::shared_ptr<const std::vector<char>> shared_data_;
+            std::unique_ptr<ActionTemplate> template_;
+            std::vector<ExtractionRule> extraction_rules_;
     };
 }
 
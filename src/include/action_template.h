@@ -0,0 +1,195 @@
+#ifndef PACKET_REPLAY_ACTION_TEMPLATE_H
+#define PACKET_REPLAY_ACTION_TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace packet_replay
+{
+    /**
+     * Maps the variable names used in scripts to dense slot numbers.  Names are resolved once when a script is
+     * loaded, so replays look variables up by slot instead of by name.
+     */
+    class VariableRegistry {
+        public:
+            /**
+             * @return the slot of the variable, added if the name is new
+             */
+            int add(std::string_view name);
+
+            /**
+             * @return the slot of the variable or -1 if the name is unknown
+             */
+            int find(std::string_view name) const;
+
+            const std::string& name(int slot) const {
+                return names_[slot];
+            }
+
+            size_t size() const {
+                return names_.size();
+            }
+
+        private:
+            std::vector<std::string> names_;
+            std::unordered_map<std::string, int> slots_;
+    };
+
+    /**
+     * The values of the variables of one replay, indexed by slot
+     */
+    class VariableTable {
+        public:
+            VariableTable() = default;
+
+            explicit VariableTable(const VariableRegistry& registry) : values_(registry.size()), set_(registry.size(), 0) {
+            }
+
+            void set(int slot, std::string_view value) {
+                if (static_cast<size_t>(slot) >= values_.size()) {
+                    values_.resize(slot + 1);
+                    set_.resize(slot + 1, 0);
+                }
+
+                values_[slot].assign(value.data(), value.size());
+                set_[slot] = 1;
+            }
+
+            bool isSet(int slot) const {
+                return static_cast<size_t>(slot) < set_.size() && set_[slot] != 0;
+            }
+
+            const std::string& get(int slot) const {
+                return values_[slot];
+            }
+
+        private:
+            std::vector<std::string> values_;
+            std::vector<uint8_t> set_;
+    };
+
+    /**
+     * The data of an action split into literal segments and variable references, compiled once when the action is
+     * loaded.  Rendering and validation are single passes over the segments.  A variable without a value stands for
+     * its reference text, e.g. "${name}", so actions replay unchanged until variables are given values.  The template
+     * is shared by all replays of the action, the values are kept by each replay.
+     */
+    class ActionTemplate {
+        public:
+            /**
+             * A run of the action data.  Literal segments are copied as is, variable segments are replaced by the
+             * value of their variable if it has one.  The offset and length are of the text in the action data.
+             */
+            class Segment {
+                public:
+                    uint32_t offset_;
+                    uint32_t length_;
+
+                    // the slot of the variable, LITERAL or CONTENT_LENGTH
+                    int slot_;
+            };
+
+            static constexpr int LITERAL = -1;
+
+            // the value of an HTTP Content-Length header, computed from the rendered body
+            static constexpr int CONTENT_LENGTH = -2;
+
+            /**
+             * Compile the data of an action
+             *
+             * @param data the action data, which must outlive the template and not change
+             * @param registry resolves the variable names to slots, adding new names
+             * @param prefix the text starting a variable reference
+             * @param suffix the text ending a variable reference
+             *
+             * @return the template or null if the data references no variables
+             */
+            static std::unique_ptr<ActionTemplate> compile(const std::vector<char>& data, VariableRegistry& registry,
+                const std::string& prefix, const std::string& suffix);
+
+            const std::vector<Segment>& segments() const {
+                return segments_;
+            }
+
+            /**
+             * Compute the value of the Content-Length header from the rendered body, so that substitutions in the body
+             * of an HTTP message keep the header correct.  Only done if the header value is the length of the body in
+             * the data, i.e. the whole body is in this action, and the value references no variable.
+             *
+             * @return whether the header is computed
+             */
+            bool computeContentLength();
+
+            /**
+             * @return the length of the rendered data
+             */
+            size_t renderedSize(const VariableTable& variables) const;
+
+            /**
+             * Replace the contents of out with the data with the variables substituted
+             */
+            void render(const VariableTable& variables, std::vector<char>& out) const;
+
+            /**
+             * Replace the contents of iov with the pieces of the rendered data, for writev.  Literal text points into
+             * the action data and values into the variable table, so nothing is copied.  Pieces that are contiguous
+             * in memory are merged.
+             *
+             * @param length receives the computed Content-Length, which iov points to
+             */
+            void gather(const VariableTable& variables, std::vector<struct iovec>& iov, std::string& length) const;
+
+            /**
+             * @return true if the data is equal to the rendered template
+             */
+            bool matches(const uint8_t* data, size_t data_len, const VariableTable& variables) const;
+
+        private:
+            // enough for the digits of any size_t
+            static constexpr size_t LENGTH_DIGITS = 24;
+
+            const char* data_;
+            size_t data_len_;
+            std::vector<Segment> segments_;
+
+            // the first segment of the HTTP body when the Content-Length is computed, 0 otherwise
+            size_t body_segment_ = 0;
+
+            ActionTemplate(const char* data, size_t data_len) : data_(data), data_len_(data_len) {
+            }
+
+            /**
+             * @param buf LENGTH_DIGITS characters to format the computed Content-Length into
+             *
+             * @return the computed Content-Length, empty if the template has none
+             */
+            std::string_view contentLength(const VariableTable& variables, char* buf) const;
+
+            /**
+             * The text that stands for a segment: the value of its variable, the computed Content-Length or its
+             * literal text
+             */
+            std::string_view text(const Segment& segment, const VariableTable& variables, std::string_view length) const {
+                if (segment.slot_ >= 0 && variables.isSet(segment.slot_)) {
+                    auto& value = variables.get(segment.slot_);
+                    return std::string_view(value.data(), value.size());
+                }
+
+                if (segment.slot_ == CONTENT_LENGTH) {
+                    return length;
+                }
+
+                return std::string_view(data_ + segment.offset_, segment.length_);
+            }
+    };
+}
+
+#endif
@@ -17,6 +17,10 @@
 #include <bit>  // For std::bit_cast.
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace base64 {
 
 namespace detail {
@@ -491,29 +495,273 @@ std::array<char, 256> constexpr encode_table_1 = {
     'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+',
     '/'};
 
+#if defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86_SIMD
+#endif
+
+#if defined(BASE64_X86_SIMD)
+
+// Vector kernels after Wojciech Mula and Daniel Lemire, "Faster Base64
+// Encoding and Decoding Using AVX2 Instructions".  Each kernel converts the
+// whole blocks it can read and write without going past the ends of the
+// buffers and returns the number of input bytes it consumed, the rest is left
+// to the scalar code.  Decoding kernels throw on characters outside the
+// alphabet, padding is never passed to them.
+
+// 6 bit values in each byte to their characters
+__attribute__((target("ssse3"))) inline __m128i encode_lookup_ssse3(
+    __m128i indices) {
+  const __m128i shift = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+  return _mm_add_epi8(_mm_shuffle_epi8(shift, result), indices);
+}
+
+// 3 bytes in each 32 bit lane to 4 6 bit values
+__attribute__((target("ssse3"))) inline __m128i encode_split_ssse3(
+    __m128i in) {
+  in = _mm_shuffle_epi8(
+      in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3"))) inline size_t encode_ssse3(
+    const uint8_t* in, size_t size, char* out) {
+  size_t i = 0;
+
+  // 12 bytes per block, read with a 16 byte load
+  for (; size - i >= 16; i += 12, out += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     encode_lookup_ssse3(encode_split_ssse3(block)));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2"))) inline size_t encode_avx2(const uint8_t* in,
+                                                          size_t size,
+                                                          char* out) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5,
+      4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i shift = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  size_t i = 0;
+
+  // 24 bytes per block, 12 in each lane read with two 16 byte loads
+  for (; size - i >= 28; i += 24, out += 32) {
+    const __m128i lo =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const __m128i hi =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+    block = _mm256_shuffle_epi8(block, shuffle);
+    const __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(t1, t3);
+
+    __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    result =
+        _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    result = _mm256_add_epi8(_mm256_shuffle_epi8(shift, result), indices);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), result);
+  }
+
+  return i + encode_ssse3(in + i, size - i, out);
+}
+
+// characters to their 6 bit values, false if a character is not in the
+// alphabet
+__attribute__((target("ssse3"))) inline bool decode_lookup_ssse3(
+    __m128i in, __m128i& values) {
+  const __m128i lut_lo =
+      _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                    0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi =
+      _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+
+  const __m128i hi_nibbles =
+      _mm_and_si128(_mm_srli_epi32(in, 4), nibble_mask);
+  const __m128i lo_nibbles = _mm_and_si128(in, nibble_mask);
+  const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+  const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                                       _mm_setzero_si128())) != 0) {
+    return false;
+  }
+
+  const __m128i eq_2f = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+  const __m128i roll =
+      _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+  values = _mm_add_epi8(in, roll);
+  return true;
+}
+
+__attribute__((target("ssse3"))) inline size_t decode_ssse3(const char* in,
+                                                            size_t size,
+                                                            uint8_t* out) {
+  size_t i = 0;
+
+  // 16 characters per block, written with a 16 byte store of which 12 bytes
+  // are decoded.  24 characters left decode to at least 16 bytes
+  for (; size - i >= 24; i += 16, out += 12) {
+    __m128i values;
+
+    if (!decode_lookup_ssse3(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)),
+            values)) {
+      throw std::runtime_error{
+          "Invalid base64 encoded data - Invalid character"};
+    }
+
+    const __m128i merged =
+        _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    packed = _mm_shuffle_epi8(
+        packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                              -1, -1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), packed);
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2"))) inline size_t decode_avx2(const char* in,
+                                                          size_t size,
+                                                          uint8_t* out) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a,
+      0x1b, 0x1b, 0x1b, 0x1a, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m256i lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4,
+      -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i pack_shuffle = _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5,
+      4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+
+  // 32 characters per block, written with a 32 byte store of which 24 bytes
+  // are decoded.  48 characters left decode to at least 32 bytes
+  for (; size - i >= 48; i += 32, out += 24) {
+    const __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    const __m256i hi_nibbles =
+        _mm256_and_si256(_mm256_srli_epi32(block, 4), nibble_mask);
+    const __m256i lo_nibbles = _mm256_and_si256(block, nibble_mask);
+    const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+
+    if (!_mm256_testz_si256(lo, hi)) {
+      throw std::runtime_error{
+          "Invalid base64 encoded data - Invalid character"};
+    }
+
+    const __m256i eq_2f = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/'));
+    const __m256i roll =
+        _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+    const __m256i values = _mm256_add_epi8(block, roll);
+
+    const __m256i merged =
+        _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    packed = _mm256_shuffle_epi8(packed, pack_shuffle);
+    packed = _mm256_permutevar8x32_epi32(
+        packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+  }
+
+  return i + decode_ssse3(in + i, size - i, out);
+}
+
+enum class simd_level { scalar, ssse3, avx2 };
+
+// the best kernels the CPU supports, detected once
+inline simd_level cpu_simd_level() {
+  static const simd_level level = [] {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+      return simd_level::avx2;
+    }
+
+    if (__builtin_cpu_supports("ssse3")) {
+      return simd_level::ssse3;
+    }
+
+    return simd_level::scalar;
+  }();
+
+  return level;
+}
+
+#endif
+
 }  // namespace detail
 
-template <class OutputBuffer, class InputIterator>
-inline OutputBuffer encode_into(InputIterator begin, InputIterator end) {
-  typedef std::decay_t<decltype(*begin)> input_value_type;
-  static_assert(std::is_same_v<input_value_type, char> ||
-                std::is_same_v<input_value_type, signed char> ||
-                std::is_same_v<input_value_type, unsigned char> ||
-                std::is_same_v<input_value_type, std::byte>);
-  typedef typename OutputBuffer::value_type output_value_type;
-  static_assert(std::is_same_v<output_value_type, char> ||
-                std::is_same_v<output_value_type, signed char> ||
-                std::is_same_v<output_value_type, unsigned char> ||
-                std::is_same_v<output_value_type, std::byte>);
-  const size_t binarytextsize = end - begin;
-  const size_t encodedsize = (binarytextsize / 3 + (binarytextsize % 3 > 0))
-                             << 2;
-  OutputBuffer encoded(encodedsize, detail::padding_char);
+// the size of the encoding of size bytes, with padding
+inline constexpr size_t encoded_size(size_t size) {
+  return (size / 3 + (size % 3 > 0)) << 2;
+}
 
-  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&*begin);
-  char* currEncoding = reinterpret_cast<char*>(&encoded[0]);
+// the largest number of bytes size characters decode to
+inline constexpr size_t max_decoded_size(size_t size) {
+  return (size >> 2) * 3;
+}
 
-  for (size_t i = binarytextsize / 3; i; --i) {
+// Encode size bytes into out, which must have room for encoded_size(size)
+// characters.  Returns the number of characters written
+inline size_t encode(const void* data, size_t size, char* out) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  char* currEncoding = out;
+  size_t done = 0;
+
+#if defined(BASE64_X86_SIMD)
+  switch (detail::cpu_simd_level()) {
+    case detail::simd_level::avx2:
+      done = detail::encode_avx2(bytes, size, out);
+      break;
+    case detail::simd_level::ssse3:
+      done = detail::encode_ssse3(bytes, size, out);
+      break;
+    case detail::simd_level::scalar:
+      break;
+  }
+
+  bytes += done;
+  currEncoding += done / 3 * 4;
+#endif
+
+  const size_t rest = size - done;
+
+  for (size_t i = rest / 3; i; --i) {
     const uint8_t t1 = *bytes++;
     const uint8_t t2 = *bytes++;
     const uint8_t t3 = *bytes++;
@@ -525,7 +773,7 @@ inline OutputBuffer encode_into(InputIterator begin, InputIterator end) {
     *currEncoding++ = detail::encode_table_1[t3];
   }
 
-  switch (binarytextsize % 3) {
+  switch (rest % 3) {
     case 0: {
       break;
     }
@@ -533,8 +781,8 @@ inline OutputBuffer encode_into(InputIterator begin, InputIterator end) {
       const uint8_t t1 = bytes[0];
       *currEncoding++ = detail::encode_table_0[t1];
       *currEncoding++ = detail::encode_table_1[(t1 & 0x03) << 4];
-      // *currEncoding++ = detail::padding_char;
-      // *currEncoding++ = detail::padding_char;
+      *currEncoding++ = detail::padding_char;
+      *currEncoding++ = detail::padding_char;
       break;
     }
     case 2: {
@@ -544,35 +792,20 @@ inline OutputBuffer encode_into(InputIterator begin, InputIterator end) {
       *currEncoding++ =
           detail::encode_table_1[((t1 & 0x03) << 4) | ((t2 >> 4) & 0x0F)];
       *currEncoding++ = detail::encode_table_1[(t2 & 0x0F) << 2];
-      // *currEncoding++ = detail::padding_char;
+      *currEncoding++ = detail::padding_char;
       break;
     }
-    default: {
-      throw std::runtime_error{"Invalid base64 encoded data"};
-    }
   }
 
-  return encoded;
+  return currEncoding - out;
 }
 
-template <class OutputBuffer>
-inline OutputBuffer encode_into(std::string_view data) {
-  return encode_into<OutputBuffer>(std::begin(data), std::end(data));
-}
-
-inline std::string to_base64(std::string_view data) {
-  return encode_into<std::string>(std::begin(data), std::end(data));
-}
-
-template <class OutputBuffer>
-inline OutputBuffer decode_into(std::string_view base64Text) {
-  typedef typename OutputBuffer::value_type output_value_type;
-  static_assert(std::is_same_v<output_value_type, char> ||
-                std::is_same_v<output_value_type, signed char> ||
-                std::is_same_v<output_value_type, unsigned char> ||
-                std::is_same_v<output_value_type, std::byte>);
+// Decode base64Text into out, which must have room for
+// max_decoded_size(base64Text.size()) bytes.  Returns the number of bytes
+// written
+inline size_t decode(std::string_view base64Text, void* out) {
   if (base64Text.empty()) {
-    return OutputBuffer();
+    return 0;
   }
 
   if ((base64Text.size() & 3) != 0) {
@@ -588,12 +821,33 @@ inline OutputBuffer decode_into(std::string_view base64Text) {
   }
 
   const size_t decodedsize = (base64Text.size() * 3 >> 2) - numPadding;
-  OutputBuffer decoded(decodedsize, '.');
 
   const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&base64Text[0]);
-  char* currDecoding = reinterpret_cast<char*>(&decoded[0]);
+  char* currDecoding = static_cast<char*>(out);
+  size_t done = 0;
+
+#if defined(BASE64_X86_SIMD)
+  // the kernels stop at least 8 characters before the end, so the padding is
+  // left to the scalar code
+  switch (detail::cpu_simd_level()) {
+    case detail::simd_level::avx2:
+      done = detail::decode_avx2(base64Text.data(), base64Text.size(),
+                                 reinterpret_cast<uint8_t*>(currDecoding));
+      break;
+    case detail::simd_level::ssse3:
+      done = detail::decode_ssse3(base64Text.data(), base64Text.size(),
+                                  reinterpret_cast<uint8_t*>(currDecoding));
+      break;
+    case detail::simd_level::scalar:
+      break;
+  }
+
+  bytes += done;
+  currDecoding += done / 4 * 3;
+#endif
 
-  for (size_t i = (base64Text.size() >> 2) - (numPadding != 0); i; --i) {
+  for (size_t i = ((base64Text.size() - done) >> 2) - (numPadding != 0); i;
+       --i) {
     const uint8_t t1 = *bytes++;
     const uint8_t t2 = *bytes++;
     const uint8_t t3 = *bytes++;
@@ -676,6 +930,51 @@ inline OutputBuffer decode_into(std::string_view base64Text) {
     }
   }
 
+  return decodedsize;
+}
+
+template <class OutputBuffer, class InputIterator>
+inline OutputBuffer encode_into(InputIterator begin, InputIterator end) {
+  typedef std::decay_t<decltype(*begin)> input_value_type;
+  static_assert(std::is_same_v<input_value_type, char> ||
+                std::is_same_v<input_value_type, signed char> ||
+                std::is_same_v<input_value_type, unsigned char> ||
+                std::is_same_v<input_value_type, std::byte>);
+  typedef typename OutputBuffer::value_type output_value_type;
+  static_assert(std::is_same_v<output_value_type, char> ||
+                std::is_same_v<output_value_type, signed char> ||
+                std::is_same_v<output_value_type, unsigned char> ||
+                std::is_same_v<output_value_type, std::byte>);
+  const size_t binarytextsize = end - begin;
+  OutputBuffer encoded(encoded_size(binarytextsize), detail::padding_char);
+
+  if (binarytextsize > 0) {
+    encode(&*begin, binarytextsize, reinterpret_cast<char*>(&encoded[0]));
+  }
+
+  return encoded;
+}
+
+template <class OutputBuffer>
+inline OutputBuffer encode_into(std::string_view data) {
+  return encode_into<OutputBuffer>(std::begin(data), std::end(data));
+}
+
+inline std::string to_base64(std::string_view data) {
+  return encode_into<std::string>(std::begin(data), std::end(data));
+}
+
+template <class OutputBuffer>
+inline OutputBuffer decode_into(std::string_view base64Text) {
+  typedef typename OutputBuffer::value_type output_value_type;
+  static_assert(std::is_same_v<output_value_type, char> ||
+                std::is_same_v<output_value_type, signed char> ||
+                std::is_same_v<output_value_type, unsigned char> ||
+                std::is_same_v<output_value_type, std::byte>);
+  OutputBuffer decoded(max_decoded_size(base64Text.size()), '.');
+
+  decoded.resize(decode(base64Text, decoded.data()));
+
   return decoded;
 }
 
@@ -696,4 +995,4 @@ inline std::string from_base64(std::string_view data) {
 
 }  // namespace base64
 
-#endif  // BASE64_HPP_
\ No newline at end of file
+#endif  // BASE64_HPP_
@@ -1,6 +1,7 @@
 #ifndef PACKET_REPLAY_CAPTURE_H
 #define PACKET_REPLAY_CAPTURE_H
 
+#include "compression.h"
 #include "conversation_store.h"
 #include "packet_conversation.h"
 #include "transport_packet.h"
@@ -13,6 +14,7 @@ namespace packet_replay {
         private:
             ConversationStore& conversation_store_;
             unsigned char datalink_type_;
+            const CompressionDictionary* dictionary_ = nullptr;
 
         public:
             /**
@@ -32,9 +34,17 @@ namespace packet_replay {
             void packetHandler(const struct pcap_pkthdr *h, const u_char *bytes);
 
             /**
-             * Load a PCAP capture file and dissect into conversations
+             * Load a PCAP capture file and dissect into conversations.  A zstd compressed capture is decompressed
+             * as it is read.
              */
             void load(const char* capture_file);
+
+            /**
+             * Decompress captures compressed with a dictionary
+             */
+            void setDictionary(const CompressionDictionary* dictionary) {
+                dictionary_ = dictionary;
+            }
     };
 }
 
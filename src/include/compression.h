@@ -0,0 +1,131 @@
+#ifndef PACKET_REPLAY_COMPRESSION_H
+#define PACKET_REPLAY_COMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace packet_replay
+{
+    /**
+     * A zstd dictionary, e.g. trained on a corpus of scripts.  Small scripts share most of their content with the
+     * other scripts of a corpus, which a dictionary provides up front, so they compress well on their own.  A file
+     * compressed with a dictionary can only be decompressed with the same dictionary.
+     *
+     * The dictionary is digested once for decompression and once per compression level used.  It is not thread safe
+     * while dictionaries for new levels are created.
+     */
+    class CompressionDictionary {
+        public:
+            /**
+             * @param file a dictionary written by train or by zstd --train
+             */
+            explicit CompressionDictionary(const std::string& file);
+            ~CompressionDictionary();
+
+            CompressionDictionary(const CompressionDictionary&) = delete;
+            CompressionDictionary& operator=(const CompressionDictionary&) = delete;
+
+            /**
+             * Train a dictionary on samples of the files to compress and write it to a file
+             *
+             * @param samples the files the dictionary is trained on, decompressed first if they are compressed
+             * @param file the dictionary file written
+             * @param size the maximum size of the dictionary
+             * @return the size of the dictionary
+             */
+            static size_t train(const std::vector<std::string>& samples, const std::string& file, size_t size);
+
+            const ZSTD_DDict_s* decompressionDictionary() const {
+                return ddict_;
+            }
+
+            const ZSTD_CDict_s* compressionDictionary(int level);
+
+        private:
+            std::vector<char> data_;
+            ZSTD_DDict_s* ddict_ = nullptr;
+            std::map<int, ZSTD_CDict_s*> cdicts_;
+    };
+
+    /**
+     * @return true if the data starts like a zstd frame
+     */
+    bool isCompressed(const char* data, size_t data_len);
+
+    /**
+     * Decompress zstd frames held in memory, e.g. a mapped file.  Frames whose headers have their size are decoded
+     * in one pass into a buffer of that size, other frames are streamed into a buffer grown as needed.
+     *
+     * @param dictionary the dictionary the data was compressed with, or null
+     * @return the decompressed data
+     */
+    std::vector<char> decompress(const char* data, size_t data_len, const CompressionDictionary* dictionary);
+
+    /**
+     * Open a file for reading through stdio, decompressing it on the fly if it is zstd compressed.  The file is read
+     * in pieces, so memory use does not grow with its size.  The stream decompresses through a cookie, which is freed
+     * when the stream is closed.
+     *
+     * @param dictionary the dictionary the file was compressed with, or null
+     * @return the stream, which the caller closes
+     */
+    FILE* openDecompressed(const std::string& file, const CompressionDictionary* dictionary);
+
+    /**
+     * A stream buffer compressing what is written through it into zstd frames written to an output stream, so a
+     * serializer writes compressed scripts without holding them in memory.  If the size of the data is known up front
+     * it is stored in the frame header, which lets readers decompress the frame in one pass into a buffer of the
+     * right size.
+     *
+     *     CompressedOutputBuffer buffer(output, 19, nullptr);
+     *     std::ostream compressed(&buffer);
+     *     serializer.write(compressed, conversation);
+     *     buffer.finish();
+     */
+    class CompressedOutputBuffer : public std::streambuf {
+        public:
+            static constexpr uint64_t UNKNOWN_SIZE = UINT64_MAX;
+
+            /**
+             * @param output the stream the compressed data is written to
+             * @param level the zstd compression level
+             * @param dictionary the dictionary to compress with, or null
+             * @param size the size of the data that will be written, which must then be exact
+             */
+            CompressedOutputBuffer(std::ostream& output, int level, CompressionDictionary* dictionary, uint64_t size = UNKNOWN_SIZE);
+            ~CompressedOutputBuffer();
+
+            CompressedOutputBuffer(const CompressedOutputBuffer&) = delete;
+            CompressedOutputBuffer& operator=(const CompressedOutputBuffer&) = delete;
+
+            /**
+             * End the frame and flush it to the output.  Must be called after the last write.
+             */
+            void finish();
+
+        protected:
+            int_type overflow(int_type ch) override;
+            std::streamsize xsputn(const char* data, std::streamsize data_len) override;
+
+        private:
+            std::ostream& output_;
+            ZSTD_CCtx_s* cctx_;
+            std::vector<char> in_buf_;
+            std::vector<char> out_buf_;
+
+            void compress(const char* data, size_t data_len, bool end);
+    };
+}
+
+#endif
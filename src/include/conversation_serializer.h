@@ -1,13 +1,19 @@
 #ifndef PACKET_REPLAY_CONVERSATION_SERIALIZER
 #define PACKET_REPLAY_CONVERSATION_SERIALIZER
 
+#include <stddef.h>
+
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "action.h"
+#include "action_template.h"
+#include "compression.h"
 #include "packet_conversation.h"
+#include "payload_store.h"
 
 namespace packet_replay {
     class ConversationSerializer {
@@ -26,19 +32,94 @@ namespace packet_replay {
 
             void write(std::ostream& output, const PacketConversation* conversation);
 
+            /**
+             * Read a text or binary script from a stream, decompressing it if it is zstd compressed
+             */
             std::unique_ptr<PacketConversation> read(std::istream& input);
 
+            /**
+             * Read a text script from a buffer, e.g. a mapped file.  The data of the actions is copied or base64
+             * decoded straight from the buffer into the actions.
+             */
+            std::unique_ptr<PacketConversation> read(const char* data, size_t data_len);
+
+            /**
+             * Write the conversation as a binary script: a versioned header, a table with an entry per action and a
+             * data section with the action data and extraction rules the entries point to.  Data is stored as is,
+             * binary data is not encoded.  Actions with equal data point to one copy of it.
+             */
+            void writeBinary(std::ostream& output, const PacketConversation* conversation);
+
+            /**
+             * Write the conversation as a binary script whose action data is kept in a payload file shared with
+             * other scripts.  Payloads not in the payload file yet are appended to it.
+             *
+             * @param payloads the payload file
+             * @param payload_file the name of the payload file stored in the script, relative to the directory of
+             *        the script
+             */
+            void writeBinary(std::ostream& output, const PacketConversation* conversation, PayloadFileWriter& payloads,
+                const std::string& payload_file);
+
+            /**
+             * Read a binary script.  The header and the action table are used in place, the data of each action is
+             * copied into the action once.  A payload file the script refers to is relative to the current directory.
+             */
+            std::unique_ptr<PacketConversation> readBinary(const char* data, size_t data_len);
+
+            /**
+             * Read a script file in either format.  Binary scripts are memory mapped and read in place.  Compressed
+             * scripts are decompressed from the mapped file into one buffer, which is read the same way.
+             */
+            std::unique_ptr<PacketConversation> load(const std::string& file);
+
+            /**
+             * Decompress scripts compressed with a dictionary.  Scripts compressed without one are read either way.
+             */
+            void setDictionary(const CompressionDictionary* dictionary) {
+                dictionary_ = dictionary;
+            }
+
+            /**
+             * Share the data of the actions read from now on through the store, so equal payloads of all scripts
+             * read are kept once.  The store must outlive the reads, not the actions.
+             */
+            void setPayloadStore(PayloadStore* payloads) {
+                payloads_ = payloads;
+            }
+
+            /**
+             * @return true if the data starts like a binary script
+             */
+            static bool isBinary(const char* data, size_t data_len);
+
+            /**
+             * The variables referenced by the actions read so far
+             */
+            VariableRegistry& variables() {
+                return variables_;
+            }
+
         private:
             DataSpecifier data_type_ = DataSpecifier::AUTO_DETECT;
             std::string data_start_tag_ = "<#DATA_START#>";
             std::string data_end_tag_ = "<#DATA_END#>";
             std::string subPrefix_ = "${";
             std::string subSuffix_ = "}";
+            VariableRegistry variables_;
+            PayloadStore* payloads_ = nullptr;
+            const CompressionDictionary* dictionary_ = nullptr;
 
             void write_action(std::ostream& output, const Action* conversation);
-            void read_actions(std::istream& input, PacketConversation& conversation);
-            std::vector<char> read_action_data(std::istream& input);
+            void read_actions(const char*& ptr, const char* end, PacketConversation& conversation);
+            std::string_view read_action_data(const char*& ptr, const char* end);
+            void write_binary(std::ostream& output, const PacketConversation* conversation, PayloadFileWriter* payloads,
+                const std::string& payload_file);
+            std::unique_ptr<PacketConversation> read_binary(const char* data, size_t data_len, const std::string& dir);
+            std::unique_ptr<PacketConversation> read_any(const char* data, size_t data_len, const std::string& dir);
             Action* create_action(Action::Type type, std::vector<char>&& data);
+            Action* create_action(Action::Type type, PayloadStore::Payload payload);
+            Action* compile_action(Action* action);
     };    
 } // namespace packet_replay
 
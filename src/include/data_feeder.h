@@ -0,0 +1,124 @@
+#ifndef PACKET_REPLAY_DATA_FEEDER_H
+#define PACKET_REPLAY_DATA_FEEDER_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <deque>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "action_template.h"
+#include "mapped_file.h"
+
+namespace packet_replay
+{
+    /**
+     * Variable values for load replays from a CSV or TSV file.  The first row names the variables, each replay of a
+     * script takes the values of one of the other rows, so one captured session is replayed as many distinct users.
+     * The file is memory mapped and indexed once; values point into the mapping.
+     */
+    class DataFeeder {
+        public:
+            enum class Mode {
+                // rows in file order, starting over after the last row
+                SEQUENTIAL,
+
+                // a random row for every replay
+                RANDOM,
+
+                // rows in file order, each row used once
+                UNIQUE
+            };
+
+            /**
+             * The position of one replay thread in the rows.  Sequential rows are shared by all cursors through an
+             * atomic counter, random rows come from a generator per cursor, so taking a row never locks.
+             */
+            class Cursor {
+                public:
+                    explicit Cursor(unsigned seed) : random_(seed) {
+                    }
+
+                private:
+                    std::minstd_rand random_;
+
+                friend DataFeeder;
+            };
+
+            /**
+             * @param file the data file.  Values are separated by tabs if the file name ends with .tsv and by commas
+             *        otherwise.  Values may be quoted with double quotes, a quote in a quoted value is doubled
+             * @param mode how rows are handed out
+             */
+            DataFeeder(const std::string& file, Mode mode);
+
+            DataFeeder(const DataFeeder&) = delete;
+            DataFeeder& operator=(const DataFeeder&) = delete;
+
+            /**
+             * @return the mode named sequential, random or unique
+             */
+            static Mode parseMode(const std::string& name);
+
+            const std::vector<std::string>& columns() const {
+                return columns_;
+            }
+
+            size_t rows() const {
+                return rows_;
+            }
+
+            std::string_view value(size_t row, size_t column) const {
+                return values_[row * columns_.size() + column];
+            }
+
+            /**
+             * Resolve the column names to variable slots.  Must be called before fill.
+             */
+            void bind(VariableRegistry& registry);
+
+            /**
+             * @return a cursor for a replay thread
+             */
+            Cursor cursor();
+
+            /**
+             * Set the variables to the values of the next row
+             *
+             * @return false if there are no rows left in unique mode
+             */
+            bool fill(Cursor& cursor, VariableTable& variables);
+
+            /**
+             * @return the number of rows handed out
+             */
+            size_t used() const {
+                return used_.load(std::memory_order_relaxed);
+            }
+
+        private:
+            Mode mode_;
+            MappedFile mapped_;
+
+            std::vector<std::string> columns_;
+            std::vector<int> slots_;
+
+            // the values row by row, pointing into the mapping or into unescaped_
+            std::vector<std::string_view> values_;
+            size_t rows_ = 0;
+
+            // quoted values with doubled quotes, after removing the escape
+            std::deque<std::string> unescaped_;
+
+            std::atomic<size_t> next_row_ = 0;
+            std::atomic<size_t> used_ = 0;
+            std::atomic<unsigned> seed_ = 0;
+
+            void parse(char delimiter, const std::string& file);
+    };
+}
+
+#endif
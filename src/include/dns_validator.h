@@ -0,0 +1,62 @@
+#ifndef PACKET_REPLAY_DNS_VALIDATOR_H
+#define PACKET_REPLAY_DNS_VALIDATOR_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packet_validator.h"
+
+namespace packet_replay
+{
+    /**
+     * Native DNS message validation.  Messages are parsed and compared field by field: names are compared
+     * case insensitively after decompression, including names inside the RDATA of the common record types, so a
+     * server compressing differently is not reported as a difference.  Messages that cannot be parsed are compared
+     * byte by byte.
+     *
+     * Each record is reduced to a 64 bit hash of its canonical form, and sections are compared by their record
+     * hashes, sorted first if the record order is ignored.
+     */
+    class DnsPacketValidator : public PacketValidator {
+        public:
+            /**
+             * @param options comma separated list of what to ignore.  Empty means "ttl".
+             *                - id - the transaction ID
+             *                - ttl - the TTL of records other than OPT
+             *                - order - the order of records within each section
+             *                - none - compare everything
+             */
+            explicit DnsPacketValidator(const std::string& options);
+
+            using PacketValidator::validate;
+            bool validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) override;
+
+        private:
+            /**
+             * A message reduced to its header fields and a hash per record
+             */
+            class Summary {
+                public:
+                    uint16_t id_;
+                    uint16_t flags_;
+                    uint16_t counts_[4];
+
+                    // question section followed by the answer, authority and additional sections
+                    std::vector<uint64_t> records_;
+            };
+
+            bool ignore_id_ = false;
+            bool ignore_ttl_ = false;
+            bool ignore_order_ = false;
+
+            // reused across messages so validation does not allocate
+            Summary expected_;
+            Summary actual_;
+
+            bool summarize(const uint8_t* data, int data_len, Summary& summary) const;
+    };
+}
+
+#endif
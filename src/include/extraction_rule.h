@@ -0,0 +1,79 @@
+#ifndef PACKET_REPLAY_EXTRACTION_RULE_H
+#define PACKET_REPLAY_EXTRACTION_RULE_H
+
+#include <stddef.h>
+
+#include <regex>
+#include <string>
+#include <string_view>
+
+#include "action_template.h"
+
+namespace packet_replay
+{
+    /**
+     * Extracts a value, e.g. a session ID, from the data received in a replay into a variable, so that later actions
+     * send the value of the live session instead of the captured one.  Rules are compiled when the script is loaded.
+     */
+    class ExtractionRule {
+        public:
+            enum class Type {
+                OFFSET,
+                BETWEEN,
+                REGEX
+            };
+
+            /**
+             * @param spec the rule.  Format: <variable name>=<type>:<argument>
+             *             - offset:<offset>+<length> - length bytes at the offset.  A negative offset counts from the
+             *               end of the data and a length of * extracts everything from the offset on
+             *             - between:<left>:<right> - the text between the first occurrence of left and the following
+             *               occurrence of right.  \: is a colon, \\ a backslash and \r, \n and \t are control
+             *               characters.  An empty left starts at the start of the data, an empty right ends at its end
+             *             - regex:<regex> - the first capture group of the first match of the ECMAScript regular
+             *               expression, or the whole match if it has no group
+             * @param registry resolves the variable name to its slot
+             */
+            ExtractionRule(const std::string& spec, VariableRegistry& registry);
+
+            Type type() const {
+                return type_;
+            }
+
+            /**
+             * The specification the rule was compiled from
+             */
+            const std::string& spec() const {
+                return spec_;
+            }
+
+            int slot() const {
+                return slot_;
+            }
+
+            /**
+             * Set the variable to the value found in the data
+             *
+             * @return false if the value is not found, the variable is left unchanged
+             */
+            bool extract(const char* data, size_t data_len, VariableTable& variables) const;
+
+        private:
+            std::string spec_;
+            Type type_;
+            int slot_;
+
+            // OFFSET: the offset and length, -1 for everything from the offset on
+            int offset_ = 0;
+            int length_ = -1;
+
+            // BETWEEN: the delimiters with the escapes replaced
+            std::string left_;
+            std::string right_;
+
+            // REGEX
+            std::regex regex_;
+    };
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef PACKET_REPLAY_MAPPED_FILE_H
+#define PACKET_REPLAY_MAPPED_FILE_H
+
+#include <stddef.h>
+
+#include <string>
+
+namespace packet_replay
+{
+    /**
+     * A file mapped read only into memory for the lifetime of the object, so its contents can be scanned or used in
+     * place without copying them into buffers first.
+     */
+    class MappedFile {
+        public:
+            /**
+             * @param file the file to map.  An empty file is not mapped and has no data
+             */
+            explicit MappedFile(const std::string& file);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char* data() const {
+                return data_;
+            }
+
+            size_t size() const {
+                return size_;
+            }
+
+        private:
+            const char* data_ = nullptr;
+            size_t size_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef PACKET_REPLAY_MASK_VALIDATOR_H
+#define PACKET_REPLAY_MASK_VALIDATOR_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "packet_validator.h"
+
+namespace packet_replay
+{
+    /**
+     * Packet validation that compares everything except declared fields.  The rules are compiled into a mask of the
+     * bits to compare at each offset from the start and from the end of a packet, and packets are compared 16 bytes
+     * at a time with the mask applied.
+     */
+    class MaskPacketValidator : public PacketValidator {
+        public:
+            /**
+             * @param rules comma separated list of ignored fields.  Offsets are decimal, negative offsets count from
+             *              the end of the packet.
+             *              - <offset> - one byte
+             *              - <offset>+<length> - length bytes
+             *              - <offset>+* - everything from the offset on, the packets may differ in length after it
+             *              - <offset>/<hex bits> - the bits of one byte, e.g. 2/0x80
+             *              - dns - the DNS transaction ID
+             *              - rtp - the RTP sequence number and timestamp
+             */
+            explicit MaskPacketValidator(const std::string& rules);
+
+            using PacketValidator::validate;
+            bool validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) override;
+
+        private:
+            // the bits to compare in the first bytes of a packet.  bytes past the end are compared completely
+            std::vector<uint8_t> head_;
+
+            // the bits to compare in the last bytes of a packet, the last element is the last byte
+            std::vector<uint8_t> tail_;
+
+            // the offset everything is ignored from, -1 if none
+            int ignore_from_ = -1;
+
+            // head and tail combined for packets too short to keep them apart.  reused so validation does not allocate
+            std::vector<uint8_t> combined_;
+
+            void ignore(int offset, int length, uint8_t bits);
+    };
+}
+
+#endif
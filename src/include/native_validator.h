@@ -0,0 +1,40 @@
+#ifndef PACKET_REPLAY_NATIVE_VALIDATOR_H
+#define PACKET_REPLAY_NATIVE_VALIDATOR_H
+
+#include <stdint.h>
+
+#include <string>
+
+#include "packet_replay_plugin.h"
+#include "packet_validator.h"
+
+namespace packet_replay
+{
+    /**
+     * Packet validation by a plugin shared library implementing the C ABI in packet_replay_plugin.h.  Each instance
+     * holds its own plugin context, so one instance must not be used by several threads at once.
+     */
+    class NativePacketValidator : public PacketValidator {
+        public:
+            /**
+             * @param library the path of the shared library
+             * @param symbol the name of the packet_replay_validator descriptor exported by the library
+             * @param options passed to the create function of the plugin
+             */
+            NativePacketValidator(const std::string& library, const std::string& symbol, const std::string& options);
+            ~NativePacketValidator();
+
+            using PacketValidator::validate;
+            bool validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) override;
+
+        private:
+            void* handle_ = nullptr;
+            const packet_replay_validator* plugin_ = nullptr;
+            void* context_ = nullptr;
+
+            NativePacketValidator(const NativePacketValidator&) = delete;
+            NativePacketValidator& operator=(const NativePacketValidator&) = delete;
+    };
+}
+
+#endif
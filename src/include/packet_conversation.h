@@ -60,7 +60,7 @@ namespace packet_replay {
                 layer3->getSockAddr(test_dest_addr_.get(), test_dest_port_, test_sock_addr_.get());    
             }
 
-            ~PacketConversation() {
+            virtual ~PacketConversation() {
                 while (!action_queue_.empty()) {
                     delete action_queue_.front();
                     action_queue_.pop_front();
@@ -96,6 +96,20 @@ namespace packet_replay {
                 return action_queue_.empty();
             }
 
+            /**
+             * The number of actions left
+             */
+            size_t actionSize() const {
+                return action_queue_.size();
+            }
+
+            /**
+             * The action at the specified position from the current action
+             */
+            Action* actionAt(size_t idx) {
+                return action_queue_[idx];
+            }
+
             /**
              * remove the current action
              */
@@ -104,11 +118,20 @@ namespace packet_replay {
                 action_queue_.pop_front();
             }
 
+            /**
+             * remove the current action and transfer its ownership to the caller
+             */
+            Action* actionRelease() {
+                auto action = action_queue_.front();
+                action_queue_.pop_front();
+                return action;
+            }
+
             void actionPush(Action* action) {
                 action_queue_.push_back(action);
             }
 
-            const std::deque<Action *> getActionQueue() const {
+            const std::deque<Action *>& getActionQueue() const {
                 return action_queue_;
             }
 
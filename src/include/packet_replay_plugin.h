@@ -0,0 +1,53 @@
+#ifndef PACKET_REPLAY_PLUGIN_H
+#define PACKET_REPLAY_PLUGIN_H
+
+/*
+ * C ABI for native packet validator plugins loaded with -k native:<library>:<symbol>[:<options>]
+ *
+ * A plugin is a shared library exporting a packet_replay_validator descriptor under <symbol>.  The replay creates a
+ * context for each thread that validates packets, so validate is never called concurrently with the same context.
+ * The packets are only valid during the call.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PACKET_REPLAY_PLUGIN_ABI_VERSION 1
+
+/**
+ * A read-only packet
+ */
+typedef struct packet_replay_span {
+    const uint8_t* data;
+    size_t len;
+} packet_replay_span;
+
+/**
+ * The validator descriptor a plugin exports
+ */
+typedef struct packet_replay_validator {
+    /* must be PACKET_REPLAY_PLUGIN_ABI_VERSION */
+    uint32_t abi_version;
+
+    /*
+     * Create a validation context.  options is the text after the symbol in the validator spec, or an empty string.
+     * Returns NULL if the options are invalid.  May be NULL if the plugin needs no context.
+     */
+    void* (*create)(const char* options);
+
+    /* Destroy a context returned by create.  May be NULL. */
+    void (*destroy)(void* context);
+
+    /* Return nonzero if the packet from the live session is equivalent to the packet from the capture */
+    int (*validate)(void* context, packet_replay_span expected, packet_replay_span actual);
+} packet_replay_validator;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
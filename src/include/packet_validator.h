@@ -1,16 +1,31 @@
 #ifndef PACKET_REPLAY_PACKET_VALIDATOR_H
 #define PACKET_REPLAY_PACKET_VALIDATOR_H
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 
-#include "properties.h"
-#include "action.h"
 #include "python_api.h"
 
 namespace packet_replay
 {
+    /**
+     * A packet from the capture and the packet from the live session to compare it with
+     */
+    class PacketPair {
+        public:
+            const uint8_t* expected_;
+            int expected_len_;
+            uint8_t* actual_;
+            int actual_len_;
+
+            // the result of the validation
+            bool equivalent_;
+    };
+
     /**
      * Class responsible for comparing packet from the capture to packets from the live session.  Default
      * implementation is a complete byte by byte comparison
@@ -27,12 +42,29 @@ namespace packet_replay
              */
             [[deprecated]]  
             virtual bool validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len);
-            virtual bool validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len, std::vector<Action::SubToken *>& sub_tokens, Properties& context);
+
+            /**
+             * Validate several packets at once.  Validators with a per call overhead override this to pay it once per
+             * batch.  The default validates each pair separately.
+             *
+             * @param pairs the packets to compare.  equivalent_ is set for each pair
+             * @param count the number of pairs
+             */
+            virtual void validate(PacketPair* pairs, size_t count);
             virtual ~PacketValidator() {}
+
+        protected:
+            /**
+             * Validate one packet with the single packet validate of the subclass
+             */
+            bool validatePacket(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len);
     };
     
     /**
-     * Packet validiation via Python callback
+     * Packet validiation via Python callback.  Isolated instances import the module into their own interpreter, which
+     * runs in parallel with the interpreters of other instances on Python 3.12 or later.  If the module cannot be
+     * imported into its own interpreter the instance falls back to the main interpreter.  An instance must be created,
+     * used and destroyed by the same thread.
      */
     class PythonPacketValidator : public PacketValidator {
         public:
@@ -41,17 +73,29 @@ namespace packet_replay
              * 
              * @param python_file the Python file with the module containing the function to call
              * @param python_func the Python function to call to validate a packet.  The function must return bool and take in two
-             *                    bytes object (expected, actual)
+             *                    read-only memoryview objects (expected, actual)
+             * @param batch if true the function takes a list of (expected, actual) tuples instead and returns a list of
+             *              bool, so a batch of packets is validated with one call
+             * @param isolated import the module into a sub-interpreter with its own GIL.  Only worth it when several
+             *                 threads validate packets
              */
             [[deprecated]]
-            PythonPacketValidator(const std::string& python_file, const std::string& python_func);
+            PythonPacketValidator(const std::string& python_file, const std::string& python_func, bool batch = false, bool isolated = false);
             ~PythonPacketValidator();
             bool validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) override;
+            void validate(PacketPair* pairs, size_t count) override;
 
         private:
+            std::unique_ptr<PythonInterpreter> interpreter_;
             ValidatePythonCall* call_;
+            bool batch_;
     };
 
+    /**
+     * Creates a validator.  Validators keep per instance state, so each thread validating packets has its own.
+     */
+    typedef std::function<PacketValidator*()> ValidatorFactory;
+
 } // namespace packet_replay
 
 
@@ -0,0 +1,136 @@
+#ifndef PACKET_REPLAY_PAYLOAD_STORE_H
+#define PACKET_REPLAY_PAYLOAD_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "action.h"
+#include "mapped_file.h"
+
+namespace packet_replay
+{
+    /**
+     * Action payloads indexed by their content, each distinct payload stored once.  Captured traffic repeats the
+     * same requests and responses over and over, so interning the data of the actions of all conversations keeps
+     * one copy of each payload in memory however many actions send or expect it.
+     *
+     * A store is not thread safe, payloads are interned while captures and scripts are loaded.  Interned payloads
+     * are immutable and may be shared by threads, they stay alive as long as an action uses them.
+     */
+    class PayloadStore {
+        public:
+            using Payload = std::shared_ptr<const std::vector<char>>;
+
+            PayloadStore() = default;
+
+            PayloadStore(const PayloadStore&) = delete;
+            PayloadStore& operator=(const PayloadStore&) = delete;
+
+            /**
+             * @return the stored payload equal to data, data itself if there is none yet
+             */
+            Payload intern(std::vector<char>&& data);
+
+            /**
+             * @return the stored payload equal to data, a copy of data if there is none yet
+             */
+            Payload intern(const char* data, size_t data_len);
+
+            /**
+             * Replace the data of the action with the stored payload equal to it.  The data is moved into the store
+             * if it is new, freed if it is not.
+             */
+            void intern(Action& action);
+
+            /**
+             * Read a payload from a payload file written with PayloadFileWriter.  The file is mapped the first time
+             * it is read and stays mapped for the lifetime of the store.
+             *
+             * @param file the payload file
+             * @param offset the offset of the payload in the file
+             * @param size the size of the payload
+             * @return the stored payload equal to the payload in the file
+             */
+            Payload read(const std::string& file, uint64_t offset, uint64_t size);
+
+            /**
+             * @return the number of distinct payloads
+             */
+            size_t payloads() const {
+                return payloads_.size();
+            }
+
+            /**
+             * @return the size of the distinct payloads
+             */
+            size_t bytes() const {
+                return bytes_;
+            }
+
+            /**
+             * @return the size of all payloads interned, including duplicates
+             */
+            size_t internedBytes() const {
+                return interned_bytes_;
+            }
+
+        private:
+            // keyed by the content of the payloads, which do not move while the store holds them
+            std::unordered_map<std::string_view, Payload> payloads_;
+            std::unordered_map<std::string, std::unique_ptr<MappedFile>> files_;
+            size_t bytes_ = 0;
+            size_t interned_bytes_ = 0;
+    };
+
+    /**
+     * Appends payloads to a payload file shared by binary scripts, so a payload common to many scripts is stored
+     * once on disk.  A payload file is a header followed by records, each a 64 bit little endian size and the
+     * payload.  Payloads already in the file are indexed when it is opened and not appended again.
+     */
+    class PayloadFileWriter {
+        public:
+            /**
+             * @param file the payload file, created if it does not exist
+             */
+            explicit PayloadFileWriter(const std::string& file);
+            ~PayloadFileWriter();
+
+            PayloadFileWriter(const PayloadFileWriter&) = delete;
+            PayloadFileWriter& operator=(const PayloadFileWriter&) = delete;
+
+            /**
+             * @return the offset of the payload in the file, where a PayloadStore reads it
+             */
+            uint64_t add(const char* data, size_t data_len);
+
+            const std::string& file() const {
+                return file_;
+            }
+
+            /**
+             * @return the size of the file
+             */
+            uint64_t size() const {
+                return size_;
+            }
+
+        private:
+            std::string file_;
+            int fd_ = -1;
+            uint64_t size_ = 0;
+
+            // hash of the content to the offsets of the payloads, compared byte by byte on a match
+            std::unordered_multimap<size_t, uint64_t> offsets_;
+
+            void index();
+            bool equals(uint64_t offset, const char* data, size_t data_len);
+    };
+}
+
+#endif
@@ -1,15 +1,83 @@
 #ifndef PACKET_REPLAY_PYTHON_API_H
 #define PACKET_REPLAY_PYTHON_API_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <stdexcept>
 #include <string>
 
 namespace packet_replay
 {
     class PythonApi;
 
+    class PacketPair;
+
     typedef struct _object PyObject;
+    typedef struct _ts PyThreadState;
+
+    /**
+     * The interpreter the calls of one thread run in.  With Python 3.12 or later an isolated instance is a
+     * sub-interpreter with its own GIL that imports its modules independently, so threads using different instances
+     * run Python in parallel.  Other instances, and all instances with older versions, share the main interpreter and
+     * take its GIL for each call.
+     *
+     * Sub-interpreters with their own GIL can only import extension modules that support them, extension modules with
+     * single-phase initialization fail to import with PythonImportError.
+     *
+     * An instance must be created, used and destroyed by the same thread.
+     */
+    class PythonInterpreter
+    {
+        public:
+            /**
+             * @param isolated create a sub-interpreter with its own GIL if the Python version supports it
+             */
+            explicit PythonInterpreter(bool isolated);
+            ~PythonInterpreter();
+
+            PythonInterpreter(const PythonInterpreter&) = delete;
+            PythonInterpreter& operator=(const PythonInterpreter&) = delete;
+
+            /**
+             * @return true if this is a sub-interpreter with its own GIL
+             */
+            bool isolated() const {
+                return tstate_ != nullptr;
+            }
+
+            /**
+             * Makes the interpreter current on the calling thread and holds its GIL while in scope
+             */
+            class Lock
+            {
+                public:
+                    explicit Lock(PythonInterpreter& interpreter);
+                    ~Lock();
+
+                    Lock(const Lock&) = delete;
+                    Lock& operator=(const Lock&) = delete;
+
+                private:
+                    PythonInterpreter& interpreter_;
+
+                    // PyGILState_STATE when the main interpreter is shared
+                    int gil_state_;
+            };
+
+        private:
+            // the thread state of the sub-interpreter, null when the main interpreter is shared
+            PyThreadState* tstate_ = nullptr;
+    };
+
+    /**
+     * Thrown when a module cannot be imported into a sub-interpreter with its own GIL, e.g. because it imports an
+     * extension module with single-phase initialization.  The module may still import into the main interpreter.
+     */
+    class PythonImportError : public std::runtime_error {
+        public:
+            using std::runtime_error::runtime_error;
+    };
 
     /**
      * Base class for objects making embedded Python calls
@@ -17,19 +85,24 @@ namespace packet_replay
     class PythonCall
     {
         protected:
+            PythonInterpreter& interpreter_;
             PyObject* py_func_;
             std::string func_name_;
 
-            PythonCall(const std::string& script_file, const std::string& func_name);
+            PythonCall(PythonInterpreter& interpreter, const std::string& script_file, const std::string& func_name);
             virtual ~PythonCall();
     };    
 
     /**
-     * A wrapper to call Python to validate packets
+     * A wrapper to call Python to validate packets.  The packets are passed as read-only memoryview objects over the
+     * caller's buffers instead of bytes copies.  The views are released when the call returns, so the function must
+     * copy anything it keeps, e.g. with bytes(view).
      */
     class ValidatePythonCall : public PythonCall {
         public:
             /**
+             * Call the function with 2 arguments (expected, actual)
+             *
              * @param expected buffer containing the expected packet
              * @param expected_len the length of the expected packet
              * @param actual buffer containing the packet under test
@@ -37,8 +110,18 @@ namespace packet_replay
              */
             bool validate(const uint8_t* expected, int expected_len, const uint8_t* actual, int actual_len);
 
+            /**
+             * Call the function once with a list of (expected, actual) tuples.  The function must return a sequence
+             * of bool with a result for each tuple.
+             *
+             * @param pairs the packets to validate.  equivalent_ is set to the result for each pair
+             * @param count the number of pairs
+             */
+            void validateBatch(PacketPair* pairs, size_t count);
+
         private:
-            ValidatePythonCall(const std::string& script_file, const std::string& func_name) : PythonCall(script_file, func_name) {
+            ValidatePythonCall(PythonInterpreter& interpreter, const std::string& script_file, const std::string& func_name) :
+                PythonCall(interpreter, script_file, func_name) {
             }
 
         friend PythonApi;
@@ -46,11 +129,16 @@ namespace packet_replay
 
     /**
      * Singleton to use for calling Python.  This is not thread safe so first getInstance must be called before threading.
+     * Calls are made through a PythonInterpreter per thread.
      */
     class PythonApi
     {
         private:
             static PythonApi* instance__;
+
+            // the main thread state, saved so the main GIL is free for the interpreters of other threads
+            PyThreadState* main_state_;
+
             PythonApi();
 
         public:
@@ -65,11 +153,12 @@ namespace packet_replay
             /**
              * Create an embedded Python call that compares and validates packets.  
              * 
+             * @param interpreter the interpreter to import the module into and make the calls in
              * @param script_file the path to the Python module contain the function call
              * @param func_name the name of the function to call 
              */
-            ValidatePythonCall* createValidateCall(const std::string& script_file, const std::string& func_name) {
-                return new ValidatePythonCall(script_file, func_name);
+            ValidatePythonCall* createValidateCall(PythonInterpreter& interpreter, const std::string& script_file, const std::string& func_name) {
+                return new ValidatePythonCall(interpreter, script_file, func_name);
             }
     };    
 
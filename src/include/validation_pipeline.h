@@ -0,0 +1,148 @@
+#ifndef PACKET_REPLAY_VALIDATION_PIPELINE_H
+#define PACKET_REPLAY_VALIDATION_PIPELINE_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+#include "packet_validator.h"
+
+namespace packet_replay
+{
+    class ValidationPipeline;
+    class ValidationQueue;
+
+    /**
+     * Work handed from a replay client to the validation threads.  validate runs on a validation thread, report runs
+     * afterwards on the thread of the client that submitted the job, in submission order.  A job must own copies of
+     * the data it validates since the client reuses its buffers.
+     */
+    class ValidationJob {
+        public:
+            virtual ~ValidationJob() {}
+
+            /**
+             * @param validator the packet validator of the validation thread, null if the pipeline has none
+             */
+            virtual void validate(PacketValidator* validator) = 0;
+
+            /**
+             * Report the result of the validation
+             */
+            virtual void report() = 0;
+
+        private:
+            std::atomic<bool> done_ = false;
+
+            // thrown by validate, rethrown on the client thread
+            std::exception_ptr error_;
+
+        friend ValidationPipeline;
+        friend ValidationQueue;
+    };
+
+    /**
+     * A pool of validation threads fed through a bounded lock-free queue, so that slow validators do not stall the
+     * threads doing socket I/O.  Each validation thread creates its own validator, so validators with per instance
+     * state and Python validators with per thread interpreters work unchanged.
+     */
+    class ValidationPipeline {
+        public:
+            /**
+             * @param threads the number of validation threads
+             * @param capacity the number of jobs the queue holds, rounded up to a power of 2
+             * @param validator_factory creates the validator of each validation thread.  may be empty for jobs that
+             *        do not use a packet validator
+             */
+            ValidationPipeline(int threads, size_t capacity, const ValidatorFactory& validator_factory);
+            ~ValidationPipeline();
+
+            ValidationPipeline(const ValidationPipeline&) = delete;
+            ValidationPipeline& operator=(const ValidationPipeline&) = delete;
+
+            /**
+             * Queue a job for validation.  Yields while the queue is full.  The job is not owned by the pipeline and
+             * must live until it is done.
+             */
+            void submit(ValidationJob* job);
+
+            size_t capacity() const {
+                return mask_ + 1;
+            }
+
+        private:
+            /**
+             * A queue slot.  The sequence tells producers and consumers whose turn the slot is.
+             */
+            class Cell {
+                public:
+                    std::atomic<size_t> sequence_;
+                    ValidationJob* job_;
+            };
+
+            std::unique_ptr<Cell[]> cells_;
+            size_t mask_;
+
+            // producers and consumers update different positions, keep them on separate cache lines
+            alignas(64) std::atomic<size_t> enqueue_pos_ = 0;
+            alignas(64) std::atomic<size_t> dequeue_pos_ = 0;
+
+            // the number of queued jobs, validation threads sleep on it while the queue is empty
+            std::counting_semaphore<> queued_{0};
+            std::atomic<bool> stop_ = false;
+            std::vector<std::thread> threads_;
+
+            bool push(ValidationJob* job);
+            ValidationJob* pop();
+            void run(std::unique_ptr<PacketValidator> validator);
+    };
+
+    /**
+     * The jobs of one replay client in submission order.  Results are reported in that order as the jobs complete, no
+     * matter which validation thread finished first.  Only used by the client thread.
+     */
+    class ValidationQueue {
+        public:
+            /**
+             * @param pipeline the pipeline validating the jobs
+             * @param max_outstanding the number of jobs submitted but not reported yet before submit waits for the
+             *        oldest one
+             */
+            ValidationQueue(ValidationPipeline& pipeline, size_t max_outstanding);
+
+            /**
+             * Waits for the outstanding jobs without reporting them
+             */
+            ~ValidationQueue();
+
+            ValidationQueue(const ValidationQueue&) = delete;
+            ValidationQueue& operator=(const ValidationQueue&) = delete;
+
+            void submit(std::unique_ptr<ValidationJob> job);
+
+            /**
+             * Report the jobs completed so far
+             */
+            void poll();
+
+            /**
+             * Wait for and report all outstanding jobs
+             */
+            void finish();
+
+        private:
+            ValidationPipeline& pipeline_;
+            size_t max_outstanding_;
+            std::deque<std::unique_ptr<ValidationJob>> jobs_;
+
+            void reportFront();
+    };
+}
+
+#endif
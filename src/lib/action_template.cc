@@ -0,0 +1,278 @@
+#include <string.h>
+#include <strings.h>
+
+#include <charconv>
+#include <stdexcept>
+
+#include "action_template.h"
+
+namespace packet_replay
+{
+    int VariableRegistry::add(std::string_view name) {
+        auto found = slots_.find(std::string(name));
+
+        if (found != slots_.end()) {
+            return found->second;
+        }
+
+        int slot = names_.size();
+
+        names_.emplace_back(name);
+        slots_.emplace(names_.back(), slot);
+
+        return slot;
+    }
+
+    int VariableRegistry::find(std::string_view name) const {
+        auto found = slots_.find(std::string(name));
+
+        return found == slots_.end() ? -1 : found->second;
+    }
+
+    /**
+     * @return the offset of the first occurrence of needle in data at or after start, or len if there is none
+     */
+    static size_t search(const char* data, size_t len, size_t start, const std::string& needle) {
+        auto first = needle[0];
+        auto pos = start;
+
+        while (pos + needle.size() <= len) {
+            auto found = static_cast<const char*>(memchr(data + pos, first, len - pos - needle.size() + 1));
+
+            if (found == nullptr) {
+                break;
+            }
+
+            pos = found - data;
+
+            if (memcmp(found + 1, needle.data() + 1, needle.size() - 1) == 0) {
+                return pos;
+            }
+
+            pos++;
+        }
+
+        return len;
+    }
+
+    std::unique_ptr<ActionTemplate> ActionTemplate::compile(const std::vector<char>& data, VariableRegistry& registry,
+        const std::string& prefix, const std::string& suffix) {
+
+        if (prefix.empty() || suffix.empty()) {
+            throw std::invalid_argument("empty variable prefix or suffix");
+        }
+
+        auto text = data.data();
+        auto len = data.size();
+
+        if (len > UINT32_MAX) {
+            throw std::runtime_error("action data of " + std::to_string(len) + " bytes is too large");
+        }
+
+        std::unique_ptr<ActionTemplate> tmpl;
+        size_t literal_start = 0;
+        size_t start = 0;
+
+        while ((start = search(text, len, start, prefix)) < len) {
+            auto name_start = start + prefix.size();
+            auto end = search(text, len, name_start, suffix);
+
+            if (end == len) {
+                break;
+            }
+
+            if (end == name_start) {
+                // "${}" is not a reference
+                start = name_start;
+                continue;
+            }
+
+            if (!tmpl) {
+                tmpl.reset(new ActionTemplate(text, len));
+            }
+
+            if (start > literal_start) {
+                tmpl->segments_.push_back({static_cast<uint32_t>(literal_start), static_cast<uint32_t>(start - literal_start), LITERAL});
+            }
+
+            auto slot = registry.add(std::string_view(text + name_start, end - name_start));
+            auto next = end + suffix.size();
+
+            tmpl->segments_.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(next - start), slot});
+            literal_start = start = next;
+        }
+
+        if (tmpl && literal_start < len) {
+            tmpl->segments_.push_back({static_cast<uint32_t>(literal_start), static_cast<uint32_t>(len - literal_start), LITERAL});
+        }
+
+        return tmpl;
+    }
+
+    bool ActionTemplate::computeContentLength() {
+        if (body_segment_ != 0) {
+            return true;
+        }
+
+        static const char HEADER[] = "content-length:";
+        constexpr size_t header_len = sizeof(HEADER) - 1;
+
+        std::string_view data(data_, data_len_);
+        auto header_end = data.find("\r\n\r\n");
+
+        if (header_end == std::string_view::npos) {
+            return false;
+        }
+
+        auto body_start = header_end + 4;
+        size_t value_start = 0;
+        size_t value_end = 0;
+
+        // the first line is the request or status line
+        for (auto pos = data.find("\r\n"); pos < header_end; pos = data.find("\r\n", pos + 2)) {
+            auto line = pos + 2;
+
+            if (line + header_len <= header_end && strncasecmp(data_ + line, HEADER, header_len) == 0) {
+                value_start = data.find_first_not_of(" \t", line + header_len);
+                value_end = value_start;
+
+                while (value_end < header_end && data[value_end] >= '0' && data[value_end] <= '9') {
+                    value_end++;
+                }
+
+                break;
+            }
+        }
+
+        size_t value = 0;
+
+        if (value_end == value_start ||
+            std::from_chars(data_ + value_start, data_ + value_end, value).ptr != data_ + value_end ||
+            value != data_len_ - body_start) {
+            return false;
+        }
+
+        // split the literal segments where the value starts and ends and where the body starts
+        std::vector<Segment> segments;
+        size_t body_segment = 0;
+
+        for (auto& segment : segments_) {
+            size_t start = segment.offset_;
+            size_t end = start + segment.length_;
+
+            if (segment.slot_ != LITERAL) {
+                if (start < value_end && end > value_start) {
+                    return false;
+                }
+
+                if (start == body_start) {
+                    body_segment = segments.size();
+                }
+
+                segments.push_back(segment);
+                continue;
+            }
+
+            for (auto cut : {value_start, value_end, body_start, end}) {
+                if (cut <= start || cut > end) {
+                    continue;
+                }
+
+                if (start == body_start) {
+                    body_segment = segments.size();
+                }
+
+                segments.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(cut - start),
+                    start == value_start ? CONTENT_LENGTH : LITERAL});
+                start = cut;
+            }
+        }
+
+        segments_ = std::move(segments);
+
+        // an empty body starts past the last segment
+        body_segment_ = body_segment != 0 ? body_segment : segments_.size();
+
+        return true;
+    }
+
+    std::string_view ActionTemplate::contentLength(const VariableTable& variables, char* buf) const {
+        if (body_segment_ == 0) {
+            return std::string_view();
+        }
+
+        size_t length = 0;
+
+        for (size_t i = body_segment_; i < segments_.size(); i++) {
+            length += text(segments_[i], variables, std::string_view()).size();
+        }
+
+        auto end = std::to_chars(buf, buf + LENGTH_DIGITS, length).ptr;
+
+        return std::string_view(buf, end - buf);
+    }
+
+    size_t ActionTemplate::renderedSize(const VariableTable& variables) const {
+        char buf[LENGTH_DIGITS];
+        auto length = contentLength(variables, buf);
+        size_t size = 0;
+
+        for (auto& segment : segments_) {
+            size += text(segment, variables, length).size();
+        }
+
+        return size;
+    }
+
+    void ActionTemplate::render(const VariableTable& variables, std::vector<char>& out) const {
+        char buf[LENGTH_DIGITS];
+        auto length = contentLength(variables, buf);
+
+        out.clear();
+
+        for (auto& segment : segments_) {
+            auto str = text(segment, variables, length);
+
+            out.insert(out.cend(), str.cbegin(), str.cend());
+        }
+    }
+
+    void ActionTemplate::gather(const VariableTable& variables, std::vector<struct iovec>& iov, std::string& length) const {
+        char buf[LENGTH_DIGITS];
+
+        length.assign(contentLength(variables, buf));
+        iov.clear();
+
+        for (auto& segment : segments_) {
+            auto str = text(segment, variables, length);
+
+            if (str.empty()) {
+                continue;
+            }
+
+            if (!iov.empty() && static_cast<const char *>(iov.back().iov_base) + iov.back().iov_len == str.data()) {
+                iov.back().iov_len += str.size();
+            } else {
+                iov.push_back({const_cast<char *>(str.data()), str.size()});
+            }
+        }
+    }
+
+    bool ActionTemplate::matches(const uint8_t* data, size_t data_len, const VariableTable& variables) const {
+        char buf[LENGTH_DIGITS];
+        auto length = contentLength(variables, buf);
+        size_t pos = 0;
+
+        for (auto& segment : segments_) {
+            auto str = text(segment, variables, length);
+
+            if (str.size() > data_len - pos || memcmp(data + pos, str.data(), str.size()) != 0) {
+                return false;
+            }
+
+            pos += str.size();
+        }
+
+        return pos == data_len;
+    }
+}
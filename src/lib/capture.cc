@@ -8,6 +8,7 @@
 #include <pcap/pcap.h>
 
 #include "capture.h"
+#include "compression.h"
 #include "network_layers.h"
 #include "packet_conversation.h"
 #include "transport_packet.h"
@@ -103,9 +104,13 @@ namespace packet_replay {
 
     void Capture::load(const char* capture_file) {
         char errbuf[PCAP_ERRBUF_SIZE];
-        pcap_t* pcap = pcap_open_offline(capture_file, errbuf);
+
+        // libpcap reads the stream, so a compressed capture is never decompressed in full
+        FILE* file = openDecompressed(capture_file, dictionary_);
+        pcap_t* pcap = pcap_fopen_offline(file, errbuf);
 
         if (!pcap) {
+            fclose(file);
             throw std::runtime_error("failed to open file: " + std::string(errbuf));
         }
 
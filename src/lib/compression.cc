@@ -0,0 +1,338 @@
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#include <zdict.h>
+#include <zstd.h>
+
+#include "compression.h"
+#include "mapped_file.h"
+
+namespace packet_replay
+{
+    // the first bytes of a zstd frame, little endian 0xFD2FB528
+    static const char ZSTD_MAGIC[4] = {'\x28', '\xb5', '\x2f', '\xfd'};
+
+    static void check(size_t rc, const std::string& what) {
+        if (ZSTD_isError(rc)) {
+            throw std::runtime_error(what + ": " + ZSTD_getErrorName(rc));
+        }
+    }
+
+    CompressionDictionary::CompressionDictionary(const std::string& file) {
+        MappedFile mapped(file);
+
+        data_.assign(mapped.data(), mapped.data() + mapped.size());
+        ddict_ = ZSTD_createDDict(data_.data(), data_.size());
+
+        if (ddict_ == nullptr) {
+            throw std::runtime_error("invalid dictionary " + file);
+        }
+    }
+
+    CompressionDictionary::~CompressionDictionary() {
+        ZSTD_freeDDict(ddict_);
+
+        for (auto& entry : cdicts_) {
+            ZSTD_freeCDict(entry.second);
+        }
+    }
+
+    const ZSTD_CDict* CompressionDictionary::compressionDictionary(int level) {
+        auto& cdict = cdicts_[level];
+
+        if (cdict == nullptr) {
+            cdict = ZSTD_createCDict(data_.data(), data_.size(), level);
+
+            if (cdict == nullptr) {
+                throw std::runtime_error("cannot create compression dictionary for level " + std::to_string(level));
+            }
+        }
+
+        return cdict;
+    }
+
+    size_t CompressionDictionary::train(const std::vector<std::string>& samples, const std::string& file, size_t size) {
+        std::vector<char> data;
+        std::vector<size_t> sizes;
+
+        for (auto& sample : samples) {
+            MappedFile mapped(sample);
+
+            if (isCompressed(mapped.data(), mapped.size())) {
+                auto decompressed = decompress(mapped.data(), mapped.size(), nullptr);
+
+                data.insert(data.cend(), decompressed.cbegin(), decompressed.cend());
+                sizes.push_back(decompressed.size());
+            } else {
+                data.insert(data.cend(), mapped.data(), mapped.data() + mapped.size());
+                sizes.push_back(mapped.size());
+            }
+        }
+
+        std::vector<char> dictionary(size);
+        auto rc = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), data.data(), sizes.data(), sizes.size());
+
+        if (ZDICT_isError(rc)) {
+            throw std::runtime_error(std::string("cannot train dictionary: ") + ZDICT_getErrorName(rc));
+        }
+
+        std::ofstream output(file, std::ios::binary);
+
+        output.write(dictionary.data(), rc);
+        output.close();
+
+        if (!output) {
+            throw std::runtime_error("cannot write " + file);
+        }
+
+        return rc;
+    }
+
+    bool isCompressed(const char* data, size_t data_len) {
+        return data_len >= sizeof(ZSTD_MAGIC) && memcmp(data, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0;
+    }
+
+    /**
+     * @return the decompressed size of the frames, or ZSTD_CONTENTSIZE_UNKNOWN if a frame header does not have it
+     */
+    static unsigned long long content_size(const char* data, size_t data_len) {
+        unsigned long long size = 0;
+
+        while (data_len > 0) {
+            auto frame_size = ZSTD_findFrameCompressedSize(data, data_len);
+            auto frame_content_size = ZSTD_getFrameContentSize(data, data_len);
+
+            if (ZSTD_isError(frame_size) || frame_content_size == ZSTD_CONTENTSIZE_UNKNOWN || frame_content_size == ZSTD_CONTENTSIZE_ERROR) {
+                return ZSTD_CONTENTSIZE_UNKNOWN;
+            }
+
+            size += frame_content_size;
+            data += frame_size;
+            data_len -= frame_size;
+        }
+
+        return size;
+    }
+
+    std::vector<char> decompress(const char* data, size_t data_len, const CompressionDictionary* dictionary) {
+        std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+
+        if (dictionary != nullptr) {
+            check(ZSTD_DCtx_refDDict(dctx.get(), dictionary->decompressionDictionary()), "cannot use dictionary");
+        }
+
+        auto size = content_size(data, data_len);
+
+        if (size != ZSTD_CONTENTSIZE_UNKNOWN) {
+            // decoded straight into the output instead of through the window of a stream
+            std::vector<char> output(size);
+
+            check(ZSTD_decompressDCtx(dctx.get(), output.data(), output.size(), data, data_len), "cannot decompress");
+
+            return output;
+        }
+
+        // streamed into a buffer doubled as it fills up
+        std::vector<char> output(std::max(data_len * 2, ZSTD_DStreamOutSize()));
+        ZSTD_inBuffer in = {data, data_len, 0};
+        ZSTD_outBuffer out = {output.data(), output.size(), 0};
+        size_t rc;
+
+        while (true) {
+            rc = ZSTD_decompressStream(dctx.get(), &out, &in);
+            check(rc, "cannot decompress");
+
+            // 0 when the frame is decoded and flushed, and the decompressor flushes what it can while there is room
+            if (in.pos == in.size && (rc == 0 || out.pos < out.size)) {
+                break;
+            }
+
+            if (out.pos == out.size) {
+                output.resize(output.size() * 2);
+                out.dst = output.data();
+                out.size = output.size();
+            }
+        }
+
+        if (rc != 0) {
+            throw std::runtime_error("truncated compressed data");
+        }
+
+        output.resize(out.pos);
+
+        return output;
+    }
+
+    /**
+     * The state of a stdio stream decompressing a file
+     */
+    struct DecompressingReader {
+        FILE* file_;
+        ZSTD_DCtx* dctx_;
+        std::vector<char> in_buf_;
+        ZSTD_inBuffer in_ = {nullptr, 0, 0};
+        bool eof_ = false;
+
+        // 0 at the end of a frame
+        size_t rc_ = 0;
+
+        ~DecompressingReader() {
+            ZSTD_freeDCtx(dctx_);
+            fclose(file_);
+        }
+    };
+
+    static ssize_t read_decompressed(void* cookie, char* buf, size_t size) {
+        auto reader = static_cast<DecompressingReader *>(cookie);
+        ZSTD_outBuffer out = {buf, size, 0};
+
+        while (out.pos == 0) {
+            if (reader->in_.pos == reader->in_.size && !reader->eof_) {
+                auto len = fread(reader->in_buf_.data(), 1, reader->in_buf_.size(), reader->file_);
+
+                if (len == 0 && ferror(reader->file_)) {
+                    return -1;
+                }
+
+                reader->eof_ = len == 0;
+                reader->in_ = {reader->in_buf_.data(), len, 0};
+            }
+
+            reader->rc_ = ZSTD_decompressStream(reader->dctx_, &out, &reader->in_);
+
+            if (ZSTD_isError(reader->rc_)) {
+                errno = EIO;
+                return -1;
+            }
+
+            if (out.pos == 0 && reader->eof_ && reader->in_.pos == reader->in_.size) {
+                if (reader->rc_ != 0) {
+                    // the file ends inside a frame
+                    errno = EIO;
+                    return -1;
+                }
+
+                break;
+            }
+        }
+
+        return out.pos;
+    }
+
+    static int close_decompressed(void* cookie) {
+        delete static_cast<DecompressingReader *>(cookie);
+
+        return 0;
+    }
+
+    FILE* openDecompressed(const std::string& file, const CompressionDictionary* dictionary) {
+        auto fp = fopen(file.c_str(), "rb");
+
+        if (fp == nullptr) {
+            throw std::runtime_error("cannot open " + file + ": " + strerror(errno));
+        }
+
+        char magic[sizeof(ZSTD_MAGIC)];
+        auto len = fread(magic, 1, sizeof(magic), fp);
+
+        rewind(fp);
+
+        if (!isCompressed(magic, len)) {
+            return fp;
+        }
+
+        auto reader = new DecompressingReader{fp, ZSTD_createDCtx(), std::vector<char>(ZSTD_DStreamInSize())};
+
+        if (dictionary != nullptr) {
+            ZSTD_DCtx_refDDict(reader->dctx_, dictionary->decompressionDictionary());
+        }
+
+        cookie_io_functions_t functions = {read_decompressed, nullptr, nullptr, close_decompressed};
+        auto stream = fopencookie(reader, "r", functions);
+
+        if (stream == nullptr) {
+            delete reader;
+            throw std::runtime_error("cannot open " + file + ": " + strerror(errno));
+        }
+
+        return stream;
+    }
+
+    CompressedOutputBuffer::CompressedOutputBuffer(std::ostream& output, int level, CompressionDictionary* dictionary, uint64_t size) :
+        output_(output), cctx_(ZSTD_createCCtx()), in_buf_(ZSTD_CStreamInSize()), out_buf_(ZSTD_CStreamOutSize()) {
+
+        try {
+            if (dictionary != nullptr) {
+                check(ZSTD_CCtx_refCDict(cctx_, dictionary->compressionDictionary(level)), "cannot use dictionary");
+            } else {
+                check(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level), "invalid compression level");
+            }
+
+            if (size != UNKNOWN_SIZE) {
+                check(ZSTD_CCtx_setPledgedSrcSize(cctx_, size), "cannot set the size");
+            }
+        } catch (...) {
+            ZSTD_freeCCtx(cctx_);
+            throw;
+        }
+
+        setp(in_buf_.data(), in_buf_.data() + in_buf_.size());
+    }
+
+    CompressedOutputBuffer::~CompressedOutputBuffer() {
+        ZSTD_freeCCtx(cctx_);
+    }
+
+    void CompressedOutputBuffer::compress(const char* data, size_t data_len, bool end) {
+        ZSTD_inBuffer in = {data, data_len, 0};
+        size_t rc;
+
+        do {
+            ZSTD_outBuffer out = {out_buf_.data(), out_buf_.size(), 0};
+
+            rc = ZSTD_compressStream2(cctx_, &out, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+            check(rc, "cannot compress");
+            output_.write(out_buf_.data(), out.pos);
+        } while (in.pos < in.size || (end && rc != 0));
+    }
+
+    CompressedOutputBuffer::int_type CompressedOutputBuffer::overflow(int_type ch) {
+        compress(pbase(), pptr() - pbase(), false);
+        setp(in_buf_.data(), in_buf_.data() + in_buf_.size());
+
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize CompressedOutputBuffer::xsputn(const char* data, std::streamsize data_len) {
+        if (data_len == 0) {
+            return 0;
+        }
+
+        if (data_len <= epptr() - pptr()) {
+            memcpy(pptr(), data, data_len);
+            pbump(data_len);
+            return data_len;
+        }
+
+        // large writes, e.g. action data, are compressed in place instead of copied through the buffer
+        overflow(traits_type::eof());
+        compress(data, data_len, false);
+
+        return data_len;
+    }
+
+    void CompressedOutputBuffer::finish() {
+        compress(pbase(), pptr() - pbase(), true);
+        setp(in_buf_.data(), in_buf_.data() + in_buf_.size());
+    }
+}
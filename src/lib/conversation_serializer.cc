@@ -1,22 +1,30 @@
+#include <algorithm>
+#include <filesystem>
 #include <iterator>
 #include <memory>
+#include <sstream>
+#include <string_view>
 #include <stdexcept>
 #include <unordered_map>
 #include <vector>
 
 #include <ctype.h>
+#include <endian.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
 
 #include "action.h"
 #include "base64.h"
+#include "compression.h"
 #include "conversation_serializer.h"
+#include "mapped_file.h"
 #include "packet_conversation.h"
+#include "payload_store.h"
 #include "tcp_conversation.h"
 #include "properties.h"
 #include "target_test_server.h"
-#include "util.h"
 #include "udp_conversation.h"
 
 namespace packet_replay {
@@ -31,24 +39,101 @@ namespace packet_replay {
     static const std::string ENCODING_PROP = "Encoding";
     static const std::string PROTOCOL_PROP = "Protocol";
 
+    // may be repeated, so it is kept out of the action properties
+    static const std::string EXTRACT_PROP = "Extract";
+
     static const char BASE64_ENCODING[] = "BASE64";
 
-    static bool is_comment(std::string& line) {
-        for (int i = 0; i < line.length(); i++) {
-            if (!isspace(line[i])) {
-                if (line[i] == '#') {
-                    return true;
-                } else {
-                    break;
-                }
-            }
+    /*
+     * Binary scripts.  A header, a table with an entry per action and a data section with the data and extraction
+     * rules of the actions.  Integers are little endian and data offsets are relative to the start of the data
+     * section.  The header and the entries are multiples of 8 bytes, so the table is aligned in a mapped file.
+     *
+     * With BINARY_PAYLOAD_FILE set the data of the actions is in a payload file, see PayloadFileWriter.  The data
+     * section then starts with the name of the payload file, a 32 bit length followed by the name, and the data
+     * offsets of the actions are offsets in the payload file.
+     */
+    static const char BINARY_MAGIC[8] = {'P', 'K', 'T', 'S', 'C', 'R', 'P', 'T'};
+
+    // incremented when the layout changes, readers reject newer versions
+    static const uint32_t BINARY_VERSION = 2;
+
+    // version 2, the action data is in a payload file
+    static const uint32_t BINARY_PAYLOAD_FILE = 1;
+
+    static const uint8_t BINARY_IPV4 = 4;
+    static const uint8_t BINARY_IPV6 = 6;
+
+    struct BinaryHeader {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t action_count_;
+
+        // IPPROTO_TCP or IPPROTO_UDP
+        uint8_t protocol_;
+
+        // BINARY_IPV4 or BINARY_IPV6
+        uint8_t address_family_;
+        uint16_t port_;
+
+        // BINARY_PAYLOAD_FILE, reserved in version 1
+        uint32_t flags_;
+
+        // the test server address, IPv4 addresses use the first 4 bytes
+        uint8_t address_[16];
+
+        // the size of the data section following the table
+        uint64_t data_size_;
+    };
+
+    struct BinaryAction {
+        // Action::Type
+        uint8_t type_;
+        uint8_t reserved_;
+        uint16_t rule_count_;
+
+        // the extraction rules, each a 32 bit length followed by the rule
+        uint32_t rules_size_;
+        uint64_t rules_offset_;
+
+        uint64_t data_offset_;
+        uint64_t data_size_;
+    };
+
+    static_assert(sizeof(BinaryHeader) == 48 && sizeof(BinaryAction) == 32, "binary script layout changed");
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && isspace(static_cast<unsigned char>(s.front()))) {
+            s.remove_prefix(1);
         }
 
-        return false;
+        while (!s.empty() && isspace(static_cast<unsigned char>(s.back()))) {
+            s.remove_suffix(1);
+        }
+
+        return s;
+    }
+
+    static bool is_comment(std::string_view line) {
+        line = trim(line);
+
+        return !line.empty() && line[0] == '#';
     }
 
-    static bool getline(std::istream& input, std::string& line) {
-        while (std::getline(input, line)) {
+    /**
+     * Find the next line at ptr that is not a comment and move ptr past it
+     *
+     * @param line set to the line without the line feed
+     * @return false at the end of the data
+     */
+    static bool next_line(const char*& ptr, const char* end, std::string_view& line) {
+        while (ptr < end) {
+            auto eol = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
+            auto line_end = eol == nullptr ? end : eol;
+
+            line = std::string_view(ptr, line_end - ptr);
+            ptr = eol == nullptr ? end : eol + 1;
+
             if (!is_comment(line)) {
                 return true;
             }
@@ -72,7 +157,7 @@ namespace packet_replay {
         }
     }
 
-    static Action::Type string_to_action_type(std::string& type) {
+    static Action::Type string_to_action_type(std::string_view type) {
 
         if (type == ACTION_CONNECT) {
             return Action::Type::CONNECT;  
@@ -90,7 +175,7 @@ namespace packet_replay {
             return Action::Type::CLOSE;  
         }
 
-        throw std::runtime_error("invalid action type " + type);
+        throw std::runtime_error("invalid action type " + std::string(type));
     }
 
     static void write_headers(std::ostream& output, const PacketConversation* conversation) {
@@ -130,110 +215,114 @@ namespace packet_replay {
                 throw std::runtime_error("Unsupported address family");        
         }
 
+        props.put(TEST_ADDRESS_PROP, ip_str);
         props.put(TEST_PORT_PROP, port_str);
 
         props.write(output);
     }
 
-    std::vector<char> ConversationSerializer::read_action_data(std::istream& input) {
-        std::vector<char> data;
-                    
-        constexpr auto buf_size = BUFSIZ;
-        char buf[buf_size + 1];
-        char* read_ptr = buf;
-        auto size = buf_size;
-
-        char delim = data_end_tag_[data_end_tag_.length() - 1];
-        
-        auto end_tag_len = data_end_tag_.length();
-
-        do {
-            // use peek to work around the fact that "get" will return 0 fail the stream if the next char is the delimiter
-            auto check = input.peek() == delim;
-            auto nread = 0;
-
-            if (!check) {
-                input.get(read_ptr, size, delim);
-                nread = input.gcount();
-                if (nread <= 0) {
-                    throw std::runtime_error("Failed to process file");
-                }
+    static std::unique_ptr<PacketConversation> create_conversation(const std::string& protocol, const std::string& address, int port) {
+        std::unique_ptr<Layer3> network_layer(nullptr);
+        struct addrinfo hint;
+        struct addrinfo* res = nullptr;
+    
+        memset(&hint, '\0', sizeof hint);
+    
+        hint.ai_family = PF_UNSPEC;
+        hint.ai_flags = AI_NUMERICHOST;
+    
+        auto ret = getaddrinfo(address.c_str(), NULL, &hint, &res);
+        if (ret) {
+            throw std::runtime_error("Unsupported address: " + address + " " + gai_strerror(ret));
+        }
 
-                if (nread != size - 1) {
-                    check = true;
-                }
-                
-                data.insert(data.cend(), buf, read_ptr + nread - end_tag_len);
-                memcpy(buf, read_ptr + nread - end_tag_len, end_tag_len);
-            }
+        if (res->ai_family == AF_INET) {
+            network_layer.reset(new IpLayerSpec());
+        } else {
+            throw std::runtime_error("Unsupported address family: " + address);
+        }
 
-            if (check) {
-                buf[end_tag_len] = input.get();
-                buf[end_tag_len + 1] = '\0';
+        freeaddrinfo(res);
 
-                if (data_end_tag_ == buf + 1) {
-                    data.push_back(buf[0]);
-                    break;
-                } else {
-                    read_ptr = buf + end_tag_len + 1;
-                    size = buf_size - (end_tag_len + 1);
-                }
-            } else {
-                read_ptr = buf + end_tag_len;
-                size = buf_size - end_tag_len;
-            }
+        if (protocol == TcpConversation::PROT_NAME) {
+            TargetTestServer target_server(address, port);
+            return std::unique_ptr<PacketConversation>(new TcpConversation(*network_layer, target_server));
+        } else if (protocol == UdpConversation::PROT_NAME) {
+            throw std::runtime_error("UDP script not supported");
+        }
 
-            if (input.eof()) {
-                break;
-            }
-        } while (true);
+        throw std::runtime_error("Unsupported protocol: " + protocol);
+    }
+
+    std::string_view ConversationSerializer::read_action_data(const char*& ptr, const char* end) {
+        auto start = ptr;
+        auto tag = static_cast<const char *>(memmem(ptr, end - ptr, data_end_tag_.data(), data_end_tag_.length()));
+
+        // data without an end tag runs to the end of the script
+        if (tag == nullptr) {
+            ptr = end;
+            return std::string_view(start, end - start);
+        }
+
+        ptr = tag + data_end_tag_.length();
 
-        return data;
+        return std::string_view(start, tag - start);
     }
 
-    void ConversationSerializer::read_actions(std::istream& input, PacketConversation& conversation) {
-        std::string line;
+    void ConversationSerializer::read_actions(const char*& ptr, const char* end, PacketConversation& conversation) {
+        std::string_view line;
         Action::Type type;
         Properties prop;
-        std::vector<char> data;
+        std::vector<std::string> extract_specs;
 
-        while (!input.eof()) {
+        while (ptr < end) {
             bool found_action = false;
-            data.clear();
+            std::string_view text;
             prop.clear();
+            extract_specs.clear();
 
-            while (getline(input, line)) {
-                if (!trim(line).empty()) {
+            while (next_line(ptr, end, line)) {
+                if (line = trim(line); !line.empty()) {
                     type = string_to_action_type(line);
                     found_action = true;
                     break;
                 }
             }
 
-            while (getline(input, line)) {
-                trim(line);
+            while (next_line(ptr, end, line)) {
+                line = trim(line);
                 if (line.empty()) {
                     continue;
                 }
 
                 if (line == data_start_tag_) {
-                    data = read_action_data(input);
+                    text = read_action_data(ptr, end);
                     break;
+                } else if (line.starts_with(EXTRACT_PROP) && line.find_first_not_of(' ', EXTRACT_PROP.size()) == line.find(':')) {
+                    extract_specs.emplace_back(trim(line.substr(line.find(':') + 1)));
                 } else {
-                    prop.put(line);
+                    std::string property(line);
+                    prop.put(property);
                 }
             }
 
             if (found_action) {
-                if (prop.contains(ENCODING_PROP) && prop.get(ENCODING_PROP) == BASE64_ENCODING) {
-                    auto decoded = base64::from_base64(std::string_view(data.data(), data.size()));
+                std::vector<char> data;
 
-                    data.clear();
-                    data.insert(data.cend(), decoded.c_str(), decoded.c_str() + decoded.length());
+                // decoded or copied straight from the script into the storage of the action
+                if (prop.contains(ENCODING_PROP) && prop.get(ENCODING_PROP) == BASE64_ENCODING) {
+                    data.resize(base64::max_decoded_size(text.size()));
+                    data.resize(base64::decode(text, data.data()));
+                } else {
+                    data.assign(text.cbegin(), text.cend());
                 }
 
                 Action* action = create_action(type, std::move(data));
 
+                for (auto& spec : extract_specs) {
+                    action->addExtractionRule(ExtractionRule(spec, variables_));
+                }
+
                 conversation.actionPush(action);
             }
         }
@@ -245,7 +334,7 @@ namespace packet_replay {
         Properties prop;
 
         auto is_binary = false;
-        auto data = action->data();
+        auto& data = action->data();
         auto data_size = data.size();
 
         for (int i = data_size - 1; i >= 0 && i > data_size - 50; i--) {
@@ -255,15 +344,25 @@ namespace packet_replay {
             }
         }
 
+        for (auto& rule : action->getExtractionRules()) {
+            output << EXTRACT_PROP << ": " << rule.spec() << std::endl;
+        }
+
         if (is_binary) {
             prop.put(ENCODING_PROP, BASE64_ENCODING);
             prop.write(output);
             output << data_start_tag_ << std::endl;
 
-            auto data_view = std::string_view(data.data(), data_size);
-            auto encoded_str = base64::to_base64(data_view);
+            // encoded in pieces through a buffer on the stack instead of into one string.  the pieces are multiples
+            // of 3 bytes, so only the last one is padded
+            char encoded[4096];
+            constexpr size_t piece = sizeof(encoded) / 4 * 3;
 
-            output << encoded_str;
+            for (size_t pos = 0; pos < data_size; pos += piece) {
+                auto len = std::min(piece, data_size - pos);
+
+                output.write(encoded, base64::encode(data.data() + pos, len, encoded));
+            }
         } else {
             output << data_start_tag_ << std::endl;
             output.write(data.data(), data_size);
@@ -283,82 +382,328 @@ namespace packet_replay {
     }
 
     std::unique_ptr<PacketConversation> ConversationSerializer::read(std::istream& input) {
+        std::ostringstream text;
 
-        std::unique_ptr<PacketConversation> ptr(nullptr);
+        text << input.rdbuf();
+
+        auto str = std::move(text).str();
+
+        return read_any(str.data(), str.size(), std::string());
+    }
+
+    std::unique_ptr<PacketConversation> ConversationSerializer::read(const char* data, size_t data_len) {
+        auto ptr = data;
+        auto end = data + data_len;
         Properties headers;
+        std::string_view line;
 
-        std::string line;
-        while (getline(input, line)) {
-            if (trimLeft(line).empty()) {
+        while (next_line(ptr, end, line)) {
+            if (line = trim(line); line.empty()) {
                 break;
             }
 
-            headers.put(line);
+            std::string header(line);
+            headers.put(header);
         }
 
+        auto conversation = create_conversation(headers.get(PROTOCOL_PROP), headers.get(TEST_ADDRESS_PROP), headers.getAsInt(TEST_PORT_PROP));
 
-        std::unique_ptr<Layer3> network_layer(nullptr);
-        struct addrinfo hint;
-        struct addrinfo* res = nullptr;
-    
-        memset(&hint, '\0', sizeof hint);
-    
-        hint.ai_family = PF_UNSPEC;
-        hint.ai_flags = AI_NUMERICHOST;
-    
-        auto ret = getaddrinfo(headers.get(TEST_ADDRESS_PROP).c_str(), NULL, &hint, &res);
-        if (ret) {
-            throw std::runtime_error("Unsupported address: " + headers.get(TEST_ADDRESS_PROP) + " " + gai_strerror(ret));
-        }
+        read_actions(ptr, end, *conversation);
 
-        if (res->ai_family == AF_INET) {
-            network_layer.reset(new IpLayerSpec());
+        return conversation;
+    }
+
+    void ConversationSerializer::writeBinary(std::ostream& output, const PacketConversation* conversation) {
+        write_binary(output, conversation, nullptr, std::string());
+    }
+
+    void ConversationSerializer::writeBinary(std::ostream& output, const PacketConversation* conversation,
+        PayloadFileWriter& payloads, const std::string& payload_file) {
+
+        write_binary(output, conversation, &payloads, payload_file);
+    }
+
+    void ConversationSerializer::write_binary(std::ostream& output, const PacketConversation* conversation,
+        PayloadFileWriter* payloads, const std::string& payload_file) {
+
+        BinaryHeader header = {};
+
+        memcpy(header.magic_, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        header.version_ = htole32(BINARY_VERSION);
+        header.action_count_ = htole32(conversation->getActionQueue().size());
+
+        if (strcmp(conversation->getProtocol(), TcpConversation::PROT_NAME) == 0) {
+            header.protocol_ = IPPROTO_TCP;
         } else {
-            throw std::runtime_error("Unsupported address family: " + headers.get(TEST_ADDRESS_PROP));
+            header.protocol_ = IPPROTO_UDP;
         }
 
-        freeaddrinfo(res);
+        switch (conversation->getAddressFamily()) {
+            case AF_INET: {
+                auto saddr = reinterpret_cast<const struct sockaddr_in*>(conversation->getTestSockAddr());
 
-        auto protocol = headers.get(PROTOCOL_PROP);
+                header.address_family_ = BINARY_IPV4;
+                header.port_ = htole16(ntohs(saddr->sin_port));
+                memcpy(header.address_, &saddr->sin_addr, sizeof(saddr->sin_addr));
+                break;
+            }
 
-        if (protocol == TcpConversation::PROT_NAME) {
-            TargetTestServer target_server(headers.get(TEST_ADDRESS_PROP), headers.getAsInt(TEST_PORT_PROP));
-            ptr.reset(new TcpConversation(*network_layer, target_server));
-        } else if (protocol == UdpConversation::PROT_NAME) {
-            throw std::runtime_error("UDP script not supported");
+            case AF_INET6: {
+                auto saddr = reinterpret_cast<const struct sockaddr_in6*>(conversation->getTestSockAddr());
+
+                header.address_family_ = BINARY_IPV6;
+                header.port_ = htole16(ntohs(saddr->sin6_port));
+                memcpy(header.address_, &saddr->sin6_addr, sizeof(saddr->sin6_addr));
+                break;
+            }
+
+            default:
+                throw std::runtime_error("Unsupported address family");
         }
 
-        read_actions(input, *ptr);
+        // the table is written before the data, so the offsets are computed first
+        std::vector<BinaryAction> table;
+        uint64_t offset = 0;
 
-        return ptr;
-    }
+        if (payloads != nullptr) {
+            header.flags_ = htole32(BINARY_PAYLOAD_FILE);
+            offset = sizeof(uint32_t) + payload_file.size();
+        }
 
-    Action* ConversationSerializer::create_action(Action::Type type, std::vector<char>&& data) {
-        Action* action = new Action(type, std::move(data));
+        // the offsets of the data written so far, so equal data is written once
+        std::unordered_map<std::string_view, uint64_t> data_offsets;
 
-        std::string_view view(data.data(), data.size());
+        for (auto action : conversation->getActionQueue()) {
+            BinaryAction entry = {};
+            uint64_t rules_size = 0;
+            auto& data = action->data();
 
-        auto start_idx = 0;
-        auto prefix_len = subPrefix_.length();
-        auto suffix_len = subSuffix_.length();
+            for (auto& rule : action->getExtractionRules()) {
+                rules_size += sizeof(uint32_t) + rule.spec().size();
+            }
 
-        while (start_idx != std::string_view::npos) {
-            start_idx = view.find(subPrefix_, start_idx);
+            entry.type_ = static_cast<uint8_t>(action->type_);
+            entry.rule_count_ = htole16(action->getExtractionRules().size());
+            entry.rules_size_ = htole32(rules_size);
+            entry.rules_offset_ = htole64(offset);
+            entry.data_size_ = htole64(data.size());
 
-            if (start_idx != std::string_view::npos)  {
-                auto end_idx = view.find(subSuffix_, start_idx + prefix_len);
+            offset += rules_size;
 
-                if (end_idx != std::string_view::npos) {
-                    action->addSubToken(view.substr(start_idx + prefix_len, end_idx), start_idx, end_idx + suffix_len);
-                    start_idx = end_idx + suffix_len;
-                } else {
-                    break;
+            if (payloads != nullptr) {
+                entry.data_offset_ = htole64(payloads->add(data.data(), data.size()));
+            } else {
+                auto found = data_offsets.emplace(std::string_view(data.data(), data.size()), offset);
+
+                entry.data_offset_ = htole64(found.first->second);
+
+                if (found.second) {
+                    offset += data.size();
                 }
+            }
+
+            table.push_back(entry);
+        }
+
+        header.data_size_ = htole64(offset);
+
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(BinaryAction));
+
+        if (payloads != nullptr) {
+            uint32_t len = htole32(payload_file.size());
+
+            output.write(reinterpret_cast<const char *>(&len), sizeof(len));
+            output.write(payload_file.data(), payload_file.size());
+        }
+
+        auto entry = table.cbegin();
+
+        for (auto action : conversation->getActionQueue()) {
+            for (auto& rule : action->getExtractionRules()) {
+                uint32_t len = htole32(rule.spec().size());
+
+                output.write(reinterpret_cast<const char *>(&len), sizeof(len));
+                output.write(rule.spec().data(), rule.spec().size());
+            }
+
+            // data written before is pointed to, not written again
+            if (payloads == nullptr && le64toh(entry->data_offset_) == le64toh(entry->rules_offset_) + le32toh(entry->rules_size_)) {
+                output.write(action->data().data(), action->data().size());
+            }
+
+            ++entry;
+        }
+    }
+
+    bool ConversationSerializer::isBinary(const char* data, size_t data_len) {
+        return data_len >= sizeof(BINARY_MAGIC) && memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0;
+    }
+
+    std::unique_ptr<PacketConversation> ConversationSerializer::readBinary(const char* data, size_t data_len) {
+        return read_binary(data, data_len, std::string());
+    }
+
+    std::unique_ptr<PacketConversation> ConversationSerializer::read_binary(const char* data, size_t data_len, const std::string& dir) {
+        BinaryHeader header;
+
+        if (data_len < sizeof(header) || !isBinary(data, data_len)) {
+            throw std::runtime_error("not a binary script");
+        }
+
+        memcpy(&header, data, sizeof(header));
+
+        if (le32toh(header.version_) > BINARY_VERSION) {
+            throw std::runtime_error("unsupported binary script version " + std::to_string(le32toh(header.version_)));
+        }
+
+        auto flags = le32toh(header.flags_);
+
+        if ((flags & ~BINARY_PAYLOAD_FILE) != 0) {
+            throw std::runtime_error("unsupported binary script flags " + std::to_string(flags));
+        }
+
+        size_t action_count = le32toh(header.action_count_);
+        uint64_t data_size = le64toh(header.data_size_);
+
+        if (action_count > (data_len - sizeof(header)) / sizeof(BinaryAction) ||
+            data_size != data_len - sizeof(header) - action_count * sizeof(BinaryAction)) {
+            throw std::runtime_error("truncated binary script");
+        }
+
+        char address[INET6_ADDRSTRLEN];
+
+        if ((header.address_family_ != BINARY_IPV4 && header.address_family_ != BINARY_IPV6) ||
+            inet_ntop(header.address_family_ == BINARY_IPV6 ? AF_INET6 : AF_INET, header.address_, address, sizeof(address)) == nullptr) {
+            throw std::runtime_error("Cannot translate address");
+        }
+
+        std::string protocol = header.protocol_ == IPPROTO_TCP ? TcpConversation::PROT_NAME :
+            header.protocol_ == IPPROTO_UDP ? UdpConversation::PROT_NAME : std::to_string(header.protocol_);
+
+        auto conversation = create_conversation(protocol, address, le16toh(header.port_));
+
+        auto table = data + sizeof(header);
+        auto section = table + action_count * sizeof(BinaryAction);
+
+        // the data of the actions is read from the payload file through a store, the payloads stay with the actions
+        std::string payload_file;
+        PayloadStore script_payloads;
+        auto& payloads = payloads_ != nullptr ? *payloads_ : script_payloads;
+
+        if ((flags & BINARY_PAYLOAD_FILE) != 0) {
+            uint32_t len;
+
+            if (data_size < sizeof(len)) {
+                throw std::runtime_error("truncated binary script");
+            }
+
+            memcpy(&len, section, sizeof(len));
+            len = le32toh(len);
+
+            if (len > data_size - sizeof(len)) {
+                throw std::runtime_error("truncated binary script");
+            }
+
+            std::filesystem::path path(std::string(section + sizeof(len), len));
+
+            payload_file = path.is_absolute() ? path.string() : (std::filesystem::path(dir) / path).string();
+        }
+
+        for (size_t i = 0; i < action_count; i++) {
+            BinaryAction entry;
+
+            memcpy(&entry, table + i * sizeof(BinaryAction), sizeof(entry));
+
+            uint64_t data_offset = le64toh(entry.data_offset_);
+            uint64_t action_data_size = le64toh(entry.data_size_);
+            uint64_t rules_offset = le64toh(entry.rules_offset_);
+            uint64_t rules_size = le32toh(entry.rules_size_);
+
+            if (entry.type_ > static_cast<uint8_t>(Action::Type::CLOSE) ||
+                (payload_file.empty() && (data_offset > data_size || action_data_size > data_size - data_offset)) ||
+                rules_offset > data_size || rules_size > data_size - rules_offset) {
+                throw std::runtime_error("invalid binary script action " + std::to_string(i));
+            }
+
+            auto type = static_cast<Action::Type>(entry.type_);
+            Action* action;
+
+            if (!payload_file.empty()) {
+                action = create_action(type, payloads.read(payload_file, data_offset, action_data_size));
+            } else if (payloads_ != nullptr) {
+                action = create_action(type, payloads_->intern(section + data_offset, action_data_size));
             } else {
-                break;
+                action = create_action(type, std::vector<char>(section + data_offset, section + data_offset + action_data_size));
             }
+
+            conversation->actionPush(action);
+
+            auto rules = section + rules_offset;
+            auto rules_end = rules + rules_size;
+
+            for (int rule = le16toh(entry.rule_count_); rule > 0; rule--) {
+                uint32_t len;
+
+                if (static_cast<size_t>(rules_end - rules) < sizeof(len)) {
+                    throw std::runtime_error("invalid binary script action " + std::to_string(i));
+                }
+
+                memcpy(&len, rules, sizeof(len));
+                len = le32toh(len);
+                rules += sizeof(len);
+
+                if (len > static_cast<size_t>(rules_end - rules)) {
+                    throw std::runtime_error("invalid binary script action " + std::to_string(i));
+                }
+
+                action->addExtractionRule(ExtractionRule(std::string(rules, len), variables_));
+                rules += len;
+            }
+        }
+
+        return conversation;
+    }
+
+    std::unique_ptr<PacketConversation> ConversationSerializer::load(const std::string& file) {
+        MappedFile mapped(file);
+
+        return read_any(mapped.data(), mapped.size(), std::filesystem::path(file).parent_path().string());
+    }
+
+    std::unique_ptr<PacketConversation> ConversationSerializer::read_any(const char* data, size_t data_len, const std::string& dir) {
+        if (isCompressed(data, data_len)) {
+            auto decompressed = decompress(data, data_len, dictionary_);
+
+            return read_any(decompressed.data(), decompressed.size(), dir);
+        }
+
+        if (isBinary(data, data_len)) {
+            return read_binary(data, data_len, dir);
         }
 
+        return read(data, data_len);
+    }
+
+    Action* ConversationSerializer::create_action(Action::Type type, std::vector<char>&& data) {
+        if (payloads_ != nullptr) {
+            return create_action(type, payloads_->intern(std::move(data)));
+        }
+
+        return compile_action(new Action(type, std::move(data)));
+    }
+
+    Action* ConversationSerializer::create_action(Action::Type type, PayloadStore::Payload payload) {
+        Action* action = new Action(type);
+
+        action->setSharedData(std::move(payload));
+
+        return compile_action(action);
+    }
+
+    Action* ConversationSerializer::compile_action(Action* action) {
+        action->setTemplate(ActionTemplate::compile(action->data(), variables_, subPrefix_, subSuffix_));
+
         return action;
     }
 
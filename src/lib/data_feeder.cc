@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include <stdexcept>
+#include <unordered_set>
+
+#include "data_feeder.h"
+#include "util.h"
+
+namespace packet_replay
+{
+    DataFeeder::DataFeeder(const std::string& file, Mode mode) : mode_(mode), mapped_(file) {
+        if (mapped_.size() == 0) {
+            throw std::runtime_error("data file " + file + " is empty");
+        }
+
+        parse(file.ends_with(".tsv") ? '\t' : ',', file);
+    }
+
+    DataFeeder::Mode DataFeeder::parseMode(const std::string& name) {
+        if (name == "sequential") {
+            return Mode::SEQUENTIAL;
+        }
+
+        if (name == "random") {
+            return Mode::RANDOM;
+        }
+
+        if (name == "unique") {
+            return Mode::UNIQUE;
+        }
+
+        throw std::invalid_argument("invalid data mode '" + name + "'");
+    }
+
+    void DataFeeder::parse(char delimiter, const std::string& file) {
+        std::vector<std::string_view> fields;
+        auto ptr = mapped_.data();
+        auto end = ptr + mapped_.size();
+        size_t line = 0;
+
+        while (ptr < end) {
+            line++;
+            fields.clear();
+
+            // one record, a quoted value may span lines
+            while (true) {
+                std::string_view field;
+
+                if (ptr < end && *ptr == '"') {
+                    auto start = ++ptr;
+                    auto escaped = false;
+
+                    while (true) {
+                        auto quote = static_cast<const char *>(memchr(ptr, '"', end - ptr));
+
+                        if (quote == nullptr) {
+                            throw std::runtime_error(file + ":" + std::to_string(line) + ": unterminated quoted value");
+                        }
+
+                        ptr = quote + 1;
+
+                        if (ptr < end && *ptr == '"') {
+                            escaped = true;
+                            ptr++;
+                        } else {
+                            break;
+                        }
+                    }
+
+                    field = std::string_view(start, ptr - 1 - start);
+
+                    if (escaped) {
+                        auto& value = unescaped_.emplace_back();
+
+                        for (size_t i = 0; i < field.size(); i++) {
+                            value.push_back(field[i]);
+
+                            if (field[i] == '"') {
+                                i++;
+                            }
+                        }
+
+                        field = value;
+                    }
+
+                    if (ptr < end && *ptr == '\r') {
+                        ptr++;
+                    }
+
+                    if (ptr < end && *ptr != delimiter && *ptr != '\n') {
+                        throw std::runtime_error(file + ":" + std::to_string(line) + ": text after a quoted value");
+                    }
+                } else {
+                    auto start = ptr;
+
+                    while (ptr < end && *ptr != delimiter && *ptr != '\n') {
+                        ptr++;
+                    }
+
+                    field = std::string_view(start, ptr - start);
+
+                    if (!field.empty() && field.back() == '\r') {
+                        field.remove_suffix(1);
+                    }
+                }
+
+                fields.push_back(field);
+
+                if (ptr == end || *ptr++ == '\n') {
+                    break;
+                }
+            }
+
+            if (fields.size() == 1 && fields[0].empty()) {
+                continue;
+            }
+
+            if (columns_.empty()) {
+                std::unordered_set<std::string> names;
+
+                for (auto& field : fields) {
+                    std::string name(field);
+
+                    if (trim(name).empty() || !names.insert(name).second) {
+                        throw std::runtime_error(file + ":" + std::to_string(line) + ": empty or duplicate column name '" + name + "'");
+                    }
+
+                    columns_.push_back(name);
+                }
+
+                continue;
+            }
+
+            if (fields.size() > columns_.size()) {
+                throw std::runtime_error(file + ":" + std::to_string(line) + ": more values than columns");
+            }
+
+            // missing values at the end of a row are empty
+            values_.insert(values_.cend(), fields.cbegin(), fields.cend());
+            values_.resize(values_.size() + columns_.size() - fields.size());
+            rows_++;
+        }
+
+        if (rows_ == 0) {
+            throw std::runtime_error("data file " + file + " has no rows");
+        }
+    }
+
+    void DataFeeder::bind(VariableRegistry& registry) {
+        slots_.clear();
+
+        for (auto& column : columns_) {
+            slots_.push_back(registry.add(column));
+        }
+    }
+
+    DataFeeder::Cursor DataFeeder::cursor() {
+        return Cursor(std::random_device()() + seed_++);
+    }
+
+    bool DataFeeder::fill(Cursor& cursor, VariableTable& variables) {
+        size_t row;
+
+        switch (mode_) {
+            case Mode::SEQUENTIAL:
+                row = next_row_.fetch_add(1, std::memory_order_relaxed) % rows_;
+                break;
+
+            case Mode::RANDOM:
+                row = std::uniform_int_distribution<size_t>(0, rows_ - 1)(cursor.random_);
+                break;
+
+            case Mode::UNIQUE:
+                row = next_row_.fetch_add(1, std::memory_order_relaxed);
+
+                if (row >= rows_) {
+                    return false;
+                }
+                break;
+        }
+
+        used_.fetch_add(1, std::memory_order_relaxed);
+
+        for (size_t i = 0; i < slots_.size(); i++) {
+            variables.set(slots_[i], value(row, i));
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,259 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dns_validator.h"
+#include "util.h"
+
+namespace packet_replay
+{
+    static const int HEADER_SIZE = 12;
+    static const int MAX_NAME_LEN = 255;
+
+    // more compression pointers than this in one name can only be a loop
+    static const int MAX_POINTERS = 64;
+
+    static const uint16_t TYPE_NS = 2;
+    static const uint16_t TYPE_CNAME = 5;
+    static const uint16_t TYPE_SOA = 6;
+    static const uint16_t TYPE_PTR = 12;
+    static const uint16_t TYPE_MX = 15;
+    static const uint16_t TYPE_SRV = 33;
+    static const uint16_t TYPE_DNAME = 39;
+    static const uint16_t TYPE_OPT = 41;
+
+    static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+    static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+    static inline uint64_t hashBytes(uint64_t h, const uint8_t* data, int len) {
+        for (int i = 0; i < len; i++) {
+            h ^= data[i];
+            h *= FNV_PRIME;
+        }
+
+        return h;
+    }
+
+    static inline uint16_t read16(const uint8_t* data) {
+        return (data[0] << 8) | data[1];
+    }
+
+    /**
+     * Hash a possibly compressed name case insensitively and advance the position past it
+     */
+    static bool hashName(const uint8_t* data, int data_len, int& pos, uint64_t& h) {
+        int ptr = pos;
+        int name_len = 0;
+        int pointers = 0;
+        bool jumped = false;
+
+        while (ptr < data_len) {
+            uint8_t label_len = data[ptr];
+
+            if ((label_len & 0xc0) == 0xc0) {
+                if (ptr + 1 >= data_len || ++pointers > MAX_POINTERS) {
+                    return false;
+                }
+
+                if (!jumped) {
+                    pos = ptr + 2;
+                    jumped = true;
+                }
+
+                ptr = ((label_len & 0x3f) << 8) | data[ptr + 1];
+                continue;
+            }
+
+            if (label_len & 0xc0) {
+                // obsolete extended label types
+                return false;
+            }
+
+            ptr++;
+
+            h ^= label_len;
+            h *= FNV_PRIME;
+
+            if (label_len == 0) {
+                if (!jumped) {
+                    pos = ptr;
+                }
+
+                return true;
+            }
+
+            name_len += label_len + 1;
+
+            if (ptr + label_len > data_len || name_len > MAX_NAME_LEN) {
+                return false;
+            }
+
+            for (int i = 0; i < label_len; i++) {
+                auto c = data[ptr + i];
+
+                h ^= (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+                h *= FNV_PRIME;
+            }
+
+            ptr += label_len;
+        }
+
+        return false;
+    }
+
+    DnsPacketValidator::DnsPacketValidator(const std::string& options) {
+        auto tokens = tokenize(options.empty() ? "ttl" : options, ',');
+
+        for (auto& token : tokens) {
+            trim(toLower(token));
+
+            if (token == "id") {
+                ignore_id_ = true;
+            } else if (token == "ttl") {
+                ignore_ttl_ = true;
+            } else if (token == "order") {
+                ignore_order_ = true;
+            } else if (token != "none") {
+                throw std::invalid_argument("invalid DNS validator option '" + token + "'");
+            }
+        }
+    }
+
+    bool DnsPacketValidator::summarize(const uint8_t* data, int data_len, Summary& summary) const {
+        if (data_len < HEADER_SIZE) {
+            return false;
+        }
+
+        summary.id_ = read16(data);
+        summary.flags_ = read16(data + 2);
+
+        for (int i = 0; i < 4; i++) {
+            summary.counts_[i] = read16(data + 4 + i * 2);
+        }
+
+        summary.records_.clear();
+
+        int pos = HEADER_SIZE;
+
+        for (int i = 0; i < summary.counts_[0]; i++) {
+            uint64_t h = FNV_OFFSET;
+
+            // name, type and class
+            if (!hashName(data, data_len, pos, h) || pos + 4 > data_len) {
+                return false;
+            }
+
+            summary.records_.push_back(hashBytes(h, data + pos, 4));
+            pos += 4;
+        }
+
+        int record_count = summary.counts_[1] + summary.counts_[2] + summary.counts_[3];
+
+        for (int i = 0; i < record_count; i++) {
+            uint64_t h = FNV_OFFSET;
+
+            // name, type, class, TTL and RDLENGTH
+            if (!hashName(data, data_len, pos, h) || pos + 10 > data_len) {
+                return false;
+            }
+
+            auto type = read16(data + pos);
+            int rdata_len = read16(data + pos + 8);
+
+            h = hashBytes(h, data + pos, 4);
+
+            // the TTL of an OPT record holds the extended RCODE and flags
+            if (!ignore_ttl_ || type == TYPE_OPT) {
+                h = hashBytes(h, data + pos + 4, 4);
+            }
+
+            pos += 10;
+
+            int rdata_end = pos + rdata_len;
+
+            if (rdata_end > data_len) {
+                return false;
+            }
+
+            // names in RDATA can be compressed
+            bool valid = true;
+
+            switch (type) {
+                case TYPE_NS:
+                case TYPE_CNAME:
+                case TYPE_PTR:
+                case TYPE_DNAME:
+                    valid = hashName(data, rdata_end, pos, h);
+                    break;
+
+                case TYPE_MX:
+                    valid = pos + 2 <= rdata_end;
+                    if (valid) {
+                        h = hashBytes(h, data + pos, 2);
+                        pos += 2;
+                        valid = hashName(data, rdata_end, pos, h);
+                    }
+                    break;
+
+                case TYPE_SRV:
+                    valid = pos + 6 <= rdata_end;
+                    if (valid) {
+                        h = hashBytes(h, data + pos, 6);
+                        pos += 6;
+                        valid = hashName(data, rdata_end, pos, h);
+                    }
+                    break;
+
+                case TYPE_SOA:
+                    valid = hashName(data, rdata_end, pos, h) && hashName(data, rdata_end, pos, h) && pos + 20 == rdata_end;
+                    if (valid) {
+                        h = hashBytes(h, data + pos, 20);
+                    }
+                    break;
+
+                default:
+                    h = hashBytes(h, data + pos, rdata_len);
+                    break;
+            }
+
+            if (!valid) {
+                return false;
+            }
+
+            summary.records_.push_back(h);
+            pos = rdata_end;
+        }
+
+        if (pos != data_len) {
+            return false;
+        }
+
+        if (ignore_order_) {
+            auto section_start = summary.records_.begin();
+
+            for (int i = 0; i < 4; i++) {
+                std::sort(section_start, section_start + summary.counts_[i]);
+                section_start += summary.counts_[i];
+            }
+        }
+
+        return true;
+    }
+
+    bool DnsPacketValidator::validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) {
+        if (!summarize(expected, expected_len, expected_) || !summarize(actual, actual_len, actual_)) {
+            return expected_len == actual_len && memcmp(expected, actual, expected_len) == 0;
+        }
+
+        if (!ignore_id_ && expected_.id_ != actual_.id_) {
+            return false;
+        }
+
+        return expected_.flags_ == actual_.flags_ &&
+            memcmp(expected_.counts_, actual_.counts_, sizeof(expected_.counts_)) == 0 &&
+            expected_.records_ == actual_.records_;
+    }
+}
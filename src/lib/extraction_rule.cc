@@ -0,0 +1,193 @@
+#include <stdexcept>
+
+#include "extraction_rule.h"
+#include "util.h"
+
+namespace packet_replay
+{
+    /**
+     * @return the text up to the first unescaped colon or the end of the argument with the escapes replaced.  pos is
+     *         set past the colon, or to npos if there is none
+     */
+    static std::string unescape(std::string_view arg, size_t& pos, const std::string& err) {
+        std::string text;
+
+        while (pos < arg.size()) {
+            auto c = arg[pos++];
+
+            if (c == ':') {
+                return text;
+            }
+
+            if (c != '\\') {
+                text.push_back(c);
+                continue;
+            }
+
+            if (pos == arg.size()) {
+                throw std::invalid_argument(err);
+            }
+
+            switch (arg[pos++]) {
+                case ':':
+                    text.push_back(':');
+                    break;
+                case '\\':
+                    text.push_back('\\');
+                    break;
+                case 'r':
+                    text.push_back('\r');
+                    break;
+                case 'n':
+                    text.push_back('\n');
+                    break;
+                case 't':
+                    text.push_back('\t');
+                    break;
+                default:
+                    throw std::invalid_argument(err);
+            }
+        }
+
+        pos = std::string_view::npos;
+
+        return text;
+    }
+
+    static int parseInt(const std::string& str, const std::string& err) {
+        size_t end;
+        int value;
+
+        try {
+            value = std::stoi(str, &end);
+        } catch (const std::exception&) {
+            end = 0;
+        }
+
+        if (end == 0 || end != str.size()) {
+            throw std::invalid_argument(err);
+        }
+
+        return value;
+    }
+
+    ExtractionRule::ExtractionRule(const std::string& spec, VariableRegistry& registry) : spec_(spec) {
+        std::string err = "invalid extraction rule '" + spec + "'";
+
+        auto name_end = spec.find('=');
+        auto type_end = spec.find(':', name_end == std::string::npos ? 0 : name_end);
+
+        if (name_end == std::string::npos || type_end == std::string::npos) {
+            throw std::invalid_argument(err);
+        }
+
+        auto name = spec.substr(0, name_end);
+        auto type_token = spec.substr(name_end + 1, type_end - name_end - 1);
+        std::string_view arg(spec.data() + type_end + 1, spec.size() - type_end - 1);
+
+        trim(name);
+        trim(toLower(type_token));
+
+        if (name.empty()) {
+            throw std::invalid_argument(err);
+        }
+
+        if (type_token == "offset") {
+            auto plus = arg.find('+');
+
+            if (plus == std::string_view::npos) {
+                throw std::invalid_argument(err);
+            }
+
+            type_ = Type::OFFSET;
+            offset_ = parseInt(std::string(arg.substr(0, plus)), err);
+
+            if (arg.substr(plus + 1) != "*") {
+                length_ = parseInt(std::string(arg.substr(plus + 1)), err);
+
+                if (length_ <= 0 || (offset_ < 0 && offset_ + length_ > 0)) {
+                    throw std::invalid_argument(err);
+                }
+            }
+        } else if (type_token == "between") {
+            size_t pos = 0;
+
+            type_ = Type::BETWEEN;
+            left_ = unescape(arg, pos, err);
+
+            if (pos == std::string_view::npos) {
+                throw std::invalid_argument(err);
+            }
+
+            right_ = unescape(arg, pos, err);
+
+            if (pos != std::string_view::npos) {
+                throw std::invalid_argument(err);
+            }
+        } else if (type_token == "regex") {
+            type_ = Type::REGEX;
+
+            try {
+                regex_ = std::regex(std::string(arg), std::regex::ECMAScript | std::regex::optimize);
+            } catch (const std::regex_error& e) {
+                throw std::invalid_argument(err + ": " + e.what());
+            }
+        } else {
+            throw std::invalid_argument(err);
+        }
+
+        slot_ = registry.add(name);
+    }
+
+    bool ExtractionRule::extract(const char* data, size_t data_len, VariableTable& variables) const {
+        std::string_view view(data, data_len);
+
+        switch (type_) {
+            case Type::OFFSET: {
+                size_t start = offset_ < 0 ? data_len + offset_ : offset_;
+
+                // a negative offset before the start of the data wraps around to a huge start
+                if (start > data_len || (length_ >= 0 && static_cast<size_t>(length_) > data_len - start)) {
+                    return false;
+                }
+
+                variables.set(slot_, view.substr(start, length_ < 0 ? std::string_view::npos : length_));
+                return true;
+            }
+
+            case Type::BETWEEN: {
+                auto start = view.find(left_);
+
+                if (start == std::string_view::npos) {
+                    return false;
+                }
+
+                start += left_.size();
+
+                auto end = right_.empty() ? data_len : view.find(right_, start);
+
+                if (end == std::string_view::npos) {
+                    return false;
+                }
+
+                variables.set(slot_, view.substr(start, end - start));
+                return true;
+            }
+
+            case Type::REGEX: {
+                std::cmatch match;
+
+                if (!std::regex_search(data, data + data_len, match, regex_)) {
+                    return false;
+                }
+
+                auto& group = match.size() > 1 ? match[1] : match[0];
+
+                variables.set(slot_, std::string_view(group.first, group.length()));
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
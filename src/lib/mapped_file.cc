@@ -0,0 +1,57 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdexcept>
+
+#include "mapped_file.h"
+
+namespace packet_replay
+{
+    MappedFile::MappedFile(const std::string& file) {
+        auto fd = open(file.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + file + ": " + strerror(errno));
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0) {
+            auto err = errno;
+            close(fd);
+            throw std::runtime_error("cannot read " + file + ": " + strerror(err));
+        }
+
+        size_ = st.st_size;
+
+        if (size_ == 0) {
+            close(fd);
+            return;
+        }
+
+        auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        auto err = errno;
+
+        close(fd);
+
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("cannot map " + file + ": " + strerror(err));
+        }
+
+        // files are mostly read front to back once
+        madvise(data, size_, MADV_SEQUENTIAL);
+
+        data_ = static_cast<const char *>(data);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char *>(data_), size_);
+        }
+    }
+}
@@ -0,0 +1,178 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mask_validator.h"
+#include "util.h"
+
+namespace packet_replay
+{
+    /**
+     * @return true if the bits set in mask are equal in a and b
+     */
+    static bool maskedEqual(const uint8_t* a, const uint8_t* b, const uint8_t* mask, size_t len) {
+        size_t i = 0;
+
+#if defined(__SSE2__)
+        for (; i + 16 <= len; i += 16) {
+            __m128i diff = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+            diff = _mm_and_si128(diff, _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + i)));
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff) {
+                return false;
+            }
+        }
+#endif
+        for (; i < len; i++) {
+            if (((a[i] ^ b[i]) & mask[i]) != 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static int parseOffset(const std::string& str, const std::string& rule) {
+        size_t end;
+        int offset;
+
+        try {
+            offset = std::stoi(str, &end);
+        } catch (const std::exception&) {
+            end = 0;
+        }
+
+        if (end == 0 || end != str.size()) {
+            throw std::invalid_argument("invalid mask rule '" + rule + "'");
+        }
+
+        return offset;
+    }
+
+    MaskPacketValidator::MaskPacketValidator(const std::string& rules) {
+        auto tokens = tokenize(rules, ',');
+
+        if (tokens.empty()) {
+            throw std::invalid_argument("no mask rules");
+        }
+
+        for (auto& token : tokens) {
+            trim(toLower(token));
+
+            if (token == "dns") {
+                ignore(0, 2, 0xff);
+                continue;
+            }
+
+            if (token == "rtp") {
+                ignore(2, 6, 0xff);
+                continue;
+            }
+
+            auto plus = token.find('+');
+            auto slash = token.find('/');
+
+            if (plus != std::string::npos) {
+                auto offset = parseOffset(token.substr(0, plus), token);
+                auto length = token.substr(plus + 1);
+
+                if (length == "*") {
+                    if (offset < 0) {
+                        throw std::invalid_argument("invalid mask rule '" + token + "'");
+                    }
+
+                    ignore_from_ = ignore_from_ < 0 ? offset : std::min(ignore_from_, offset);
+                } else {
+                    ignore(offset, parseOffset(length, token), 0xff);
+                }
+            } else if (slash != std::string::npos) {
+                auto bits = token.substr(slash + 1);
+                size_t end = 0;
+                unsigned long value = 0;
+
+                try {
+                    value = std::stoul(bits, &end, 16);
+                } catch (const std::exception&) {
+                    end = 0;
+                }
+
+                if (end == 0 || end != bits.size() || value > 0xff) {
+                    throw std::invalid_argument("invalid mask rule '" + token + "'");
+                }
+
+                ignore(parseOffset(token.substr(0, slash), token), 1, static_cast<uint8_t>(value));
+            } else {
+                ignore(parseOffset(token, token), 1, 0xff);
+            }
+        }
+
+        // the end of packets of different length does not line up
+        if (ignore_from_ >= 0 && !tail_.empty()) {
+            throw std::invalid_argument("mask rules relative to the end cannot be combined with <offset>+*");
+        }
+    }
+
+    void MaskPacketValidator::ignore(int offset, int length, uint8_t bits) {
+        if (length <= 0) {
+            throw std::invalid_argument("invalid mask length " + std::to_string(length));
+        }
+
+        if (offset >= 0) {
+            if (head_.size() < static_cast<size_t>(offset + length)) {
+                head_.resize(offset + length, 0xff);
+            }
+
+            for (int i = offset; i < offset + length; i++) {
+                head_[i] &= ~bits;
+            }
+        } else {
+            if (offset + length > 0) {
+                throw std::invalid_argument("mask field at offset " + std::to_string(offset) + " runs past the end of the packet");
+            }
+
+            if (tail_.size() < static_cast<size_t>(-offset)) {
+                tail_.insert(tail_.begin(), -offset - tail_.size(), 0xff);
+            }
+
+            for (int i = tail_.size() + offset; i < static_cast<int>(tail_.size()) + offset + length; i++) {
+                tail_[i] &= ~bits;
+            }
+        }
+    }
+
+    bool MaskPacketValidator::validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) {
+        size_t len = expected_len;
+
+        if (ignore_from_ >= 0 && expected_len >= ignore_from_ && actual_len >= ignore_from_) {
+            len = ignore_from_;
+        } else if (expected_len != actual_len) {
+            return false;
+        }
+
+        auto head_len = std::min(head_.size(), len);
+        auto tail_len = std::min(tail_.size(), len);
+
+        if (head_len + tail_len > len) {
+            // the head and tail fields overlap in a short packet, a byte is compared only if both masks compare it
+            combined_.assign(len, 0xff);
+            std::copy(head_.cbegin(), head_.cbegin() + head_len, combined_.begin());
+
+            for (size_t i = 0; i < tail_len; i++) {
+                combined_[len - tail_len + i] &= tail_[tail_.size() - tail_len + i];
+            }
+
+            return maskedEqual(expected, actual, combined_.data(), len);
+        }
+
+        return maskedEqual(expected, actual, head_.data(), head_len) &&
+            memcmp(expected + head_len, actual + head_len, len - head_len - tail_len) == 0 &&
+            maskedEqual(expected + len - tail_len, actual + len - tail_len, tail_.data() + tail_.size() - tail_len, tail_len);
+    }
+}
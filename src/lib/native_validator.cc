@@ -0,0 +1,54 @@
+#include <dlfcn.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "native_validator.h"
+
+namespace packet_replay
+{
+    NativePacketValidator::NativePacketValidator(const std::string& library, const std::string& symbol, const std::string& options) {
+        handle_ = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+        if (handle_ == nullptr) {
+            throw std::runtime_error("dlopen failed: " + std::string(dlerror()));
+        }
+
+        plugin_ = static_cast<const packet_replay_validator *>(dlsym(handle_, symbol.c_str()));
+
+        if (plugin_ == nullptr) {
+            dlclose(handle_);
+            throw std::runtime_error("validator " + symbol + " not found in " + library);
+        }
+
+        if (plugin_->abi_version != PACKET_REPLAY_PLUGIN_ABI_VERSION || plugin_->validate == nullptr) {
+            dlclose(handle_);
+            throw std::runtime_error("validator " + symbol + " in " + library + " has an unsupported ABI version " +
+                std::to_string(plugin_->abi_version));
+        }
+
+        if (plugin_->create != nullptr) {
+            context_ = plugin_->create(options.c_str());
+
+            if (context_ == nullptr) {
+                dlclose(handle_);
+                throw std::invalid_argument("invalid options '" + options + "' for validator " + symbol);
+            }
+        }
+    }
+
+    NativePacketValidator::~NativePacketValidator() {
+        if (context_ != nullptr && plugin_->destroy != nullptr) {
+            plugin_->destroy(context_);
+        }
+
+        dlclose(handle_);
+    }
+
+    bool NativePacketValidator::validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) {
+        packet_replay_span expected_span = { expected, static_cast<size_t>(expected_len) };
+        packet_replay_span actual_span = { actual, static_cast<size_t>(actual_len) };
+
+        return plugin_->validate(context_, expected_span, actual_span) != 0;
+    }
+}
@@ -1,5 +1,7 @@
 #include <string.h>
 
+#include <iostream>
+
 #include "packet_validator.h"
 #include "python_api.h"
 
@@ -12,49 +14,32 @@ namespace packet_replay
 
         return true;
     }
-    
-    bool PacketValidator::validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len, 
-        std::vector<Action::SubToken *>& sub_tokens, Properties& context) {
-
-        int actual_idx = 0;
-        int start_idx = 0;
-        for (auto sub_token : sub_tokens) {
-            auto len = sub_token->get_begin() - start_idx;
-
-            if (len > 0 && memcmp(expected + start_idx, actual + start_idx, len) != 0) {
-                return false;
-            }
-
-            if (context.contains(sub_token->get_token())) {
-                auto value = context.get(sub_token->get_token());
-
-                if (memcmp(value.c_str(), actual + start_idx, value.size()) != 0) {
-                    return false;
-                } else {
-                    actual_idx += value.size();
-                }
-            } else if (memcmp(expected + start_idx, actual + actual_idx, sub_token->get_end() - sub_token->get_begin()) != 0) {
-                return false;
-            } else {
-                actual_idx += sub_token->get_end() - sub_token->get_begin();
-            }
-
-            start_idx = sub_token->get_end();
-        }
 
-        auto remaining_actual = actual_len - actual_idx;
-        auto remaining_expected = expected_len - start_idx;
 
-        if (remaining_actual != remaining_expected ||
-            memcmp(actual + actual_idx, expected + expected_len, remaining_actual) != 0) {
-                return false;
-        }
+    bool PacketValidator::validatePacket(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) {
+        // the single packet validate is deprecated for callers, but it is what subclasses override
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        return validate(expected, expected_len, actual, actual_len);
+#pragma GCC diagnostic pop
+    }
 
-        return true;
+    void PacketValidator::validate(PacketPair* pairs, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            pairs[i].equivalent_ = validatePacket(pairs[i].expected_, pairs[i].expected_len_, pairs[i].actual_, pairs[i].actual_len_);
+        }
     }
 
-    PythonPacketValidator::PythonPacketValidator(const std::string& python_file, const std::string& python_func) {
-        call_ = PythonApi::getInstance()->createValidateCall(python_file, python_func);
+    PythonPacketValidator::PythonPacketValidator(const std::string& python_file, const std::string& python_func, bool batch, bool isolated) :
+        interpreter_(new PythonInterpreter(isolated)), batch_(batch) {
+        try {
+            call_ = PythonApi::getInstance()->createValidateCall(*interpreter_, python_file, python_func);
+        } catch (const PythonImportError& e) {
+            std::cerr << e.what() << ", validating in the main interpreter" << std::endl;
+
+            interpreter_.reset(new PythonInterpreter(false));
+            call_ = PythonApi::getInstance()->createValidateCall(*interpreter_, python_file, python_func);
+        }
     }
 
     PythonPacketValidator::~PythonPacketValidator() {
@@ -62,8 +47,24 @@ namespace packet_replay
     }
 
     bool PythonPacketValidator::validate(const uint8_t* expected, int expected_len, uint8_t* actual, int actual_len) {
+        if (batch_) {
+            PacketPair pair{expected, expected_len, actual, actual_len, false};
+
+            call_->validateBatch(&pair, 1);
+
+            return pair.equivalent_;
+        }
+
         return call_->validate(expected, expected_len, actual, actual_len);
     }
+
+    void PythonPacketValidator::validate(PacketPair* pairs, size_t count) {
+        if (batch_) {
+            call_->validateBatch(pairs, count);
+        } else {
+            PacketValidator::validate(pairs, count);
+        }
+    }
     
 } // namespace packet_replay
 
@@ -0,0 +1,211 @@
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/uio.h>
+
+#include <functional>
+#include <stdexcept>
+
+#include "payload_store.h"
+
+namespace packet_replay
+{
+    /*
+     * Payload files.  A header followed by records, each a 64 bit little endian size and the payload.  Scripts
+     * refer to a payload by the offset of the payload in the file, past its size.
+     */
+    static const char PAYLOAD_MAGIC[8] = {'P', 'K', 'T', 'P', 'A', 'Y', 'L', 'D'};
+
+    // incremented when the layout changes, readers reject newer versions
+    static const uint32_t PAYLOAD_VERSION = 1;
+
+    struct PayloadHeader {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t reserved_;
+    };
+
+    static_assert(sizeof(PayloadHeader) == 16, "payload file layout changed");
+
+    static void check_header(const std::string& file, const char* data, size_t data_len) {
+        PayloadHeader header;
+
+        if (data_len < sizeof(header) || memcmp(data, PAYLOAD_MAGIC, sizeof(PAYLOAD_MAGIC)) != 0) {
+            throw std::runtime_error(file + " is not a payload file");
+        }
+
+        memcpy(&header, data, sizeof(header));
+
+        if (le32toh(header.version_) > PAYLOAD_VERSION) {
+            throw std::runtime_error("unsupported payload file version " + std::to_string(le32toh(header.version_)) + " in " + file);
+        }
+    }
+
+    PayloadStore::Payload PayloadStore::intern(std::vector<char>&& data) {
+        interned_bytes_ += data.size();
+
+        auto found = payloads_.find(std::string_view(data.data(), data.size()));
+
+        if (found != payloads_.end()) {
+            return found->second;
+        }
+
+        auto payload = std::make_shared<const std::vector<char>>(std::move(data));
+
+        payloads_.emplace(std::string_view(payload->data(), payload->size()), payload);
+        bytes_ += payload->size();
+
+        return payload;
+    }
+
+    PayloadStore::Payload PayloadStore::intern(const char* data, size_t data_len) {
+        auto found = payloads_.find(std::string_view(data, data_len));
+
+        if (found != payloads_.end()) {
+            interned_bytes_ += data_len;
+            return found->second;
+        }
+
+        return intern(std::vector<char>(data, data + data_len));
+    }
+
+    void PayloadStore::intern(Action& action) {
+        if (!action.hasSharedData()) {
+            action.setSharedData(intern(std::move(action.mutableData())));
+        }
+    }
+
+    PayloadStore::Payload PayloadStore::read(const std::string& file, uint64_t offset, uint64_t size) {
+        auto& mapped = files_[file];
+
+        if (!mapped) {
+            auto opened = std::make_unique<MappedFile>(file);
+
+            check_header(file, opened->data(), opened->size());
+            mapped = std::move(opened);
+        }
+
+        uint64_t record_size;
+
+        if (offset < sizeof(PayloadHeader) + sizeof(record_size) || offset > mapped->size() || size > mapped->size() - offset) {
+            throw std::runtime_error("invalid payload offset " + std::to_string(offset) + " in " + file);
+        }
+
+        memcpy(&record_size, mapped->data() + offset - sizeof(record_size), sizeof(record_size));
+
+        if (le64toh(record_size) != size) {
+            throw std::runtime_error("invalid payload offset " + std::to_string(offset) + " in " + file);
+        }
+
+        return intern(mapped->data() + offset, size);
+    }
+
+    PayloadFileWriter::PayloadFileWriter(const std::string& file) : file_(file) {
+        fd_ = open(file.c_str(), O_RDWR | O_CREAT, 0644);
+
+        if (fd_ < 0) {
+            throw std::runtime_error("cannot open " + file + ": " + strerror(errno));
+        }
+
+        try {
+            index();
+        } catch (...) {
+            close(fd_);
+            throw;
+        }
+    }
+
+    PayloadFileWriter::~PayloadFileWriter() {
+        close(fd_);
+    }
+
+    void PayloadFileWriter::index() {
+        MappedFile mapped(file_);
+
+        if (mapped.size() == 0) {
+            PayloadHeader header = {};
+
+            memcpy(header.magic_, PAYLOAD_MAGIC, sizeof(PAYLOAD_MAGIC));
+            header.version_ = htole32(PAYLOAD_VERSION);
+
+            if (pwrite(fd_, &header, sizeof(header), 0) != sizeof(header)) {
+                throw std::runtime_error("cannot write " + file_ + ": " + strerror(errno));
+            }
+
+            size_ = sizeof(header);
+            return;
+        }
+
+        check_header(file_, mapped.data(), mapped.size());
+
+        uint64_t offset = sizeof(PayloadHeader);
+
+        while (offset < mapped.size()) {
+            uint64_t record_size;
+
+            if (mapped.size() - offset < sizeof(record_size)) {
+                throw std::runtime_error("truncated payload file " + file_);
+            }
+
+            memcpy(&record_size, mapped.data() + offset, sizeof(record_size));
+            record_size = le64toh(record_size);
+            offset += sizeof(record_size);
+
+            if (record_size > mapped.size() - offset) {
+                throw std::runtime_error("truncated payload file " + file_);
+            }
+
+            offsets_.emplace(std::hash<std::string_view>()(std::string_view(mapped.data() + offset, record_size)), offset);
+            offset += record_size;
+        }
+
+        size_ = offset;
+    }
+
+    bool PayloadFileWriter::equals(uint64_t offset, const char* data, size_t data_len) {
+        uint64_t record_size;
+
+        if (pread(fd_, &record_size, sizeof(record_size), offset - sizeof(record_size)) != sizeof(record_size) ||
+            le64toh(record_size) != data_len) {
+            return false;
+        }
+
+        if (data_len == 0) {
+            return true;
+        }
+
+        std::vector<char> stored(data_len);
+
+        return pread(fd_, stored.data(), data_len, offset) == static_cast<ssize_t>(data_len) &&
+            memcmp(stored.data(), data, data_len) == 0;
+    }
+
+    uint64_t PayloadFileWriter::add(const char* data, size_t data_len) {
+        auto hash = std::hash<std::string_view>()(std::string_view(data, data_len));
+        auto range = offsets_.equal_range(hash);
+
+        for (auto it = range.first; it != range.second; ++it) {
+            if (equals(it->second, data, data_len)) {
+                return it->second;
+            }
+        }
+
+        uint64_t record_size = htole64(data_len);
+        struct iovec iov[2] = {{&record_size, sizeof(record_size)}, {const_cast<char *>(data), data_len}};
+        auto len = static_cast<ssize_t>(sizeof(record_size) + data_len);
+
+        if (pwritev(fd_, iov, 2, size_) != len) {
+            throw std::runtime_error("cannot write " + file_ + ": " + strerror(errno));
+        }
+
+        auto offset = size_ + sizeof(record_size);
+
+        offsets_.emplace(hash, offset);
+        size_ += len;
+
+        return offset;
+    }
+}
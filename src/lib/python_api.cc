@@ -2,10 +2,12 @@
 #include <filesystem>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
+#include "packet_validator.h"
 #include "python_api.h"
 
 namespace packet_replay
@@ -22,13 +24,84 @@ namespace packet_replay
 
     PythonApi::PythonApi() {
         Py_Initialize();
+
+        // the interpreters take the GIL when they make calls
+        main_state_ = PyEval_SaveThread();
     }
 
     PythonApi::~PythonApi() {
+        PyEval_RestoreThread(main_state_);
         Py_Finalize();
     }
 
-    PythonCall::PythonCall(const std::string& script_file, const std::string& func_name) {
+    PythonInterpreter::PythonInterpreter([[maybe_unused]] bool isolated) {
+        PythonApi::getInstance();
+
+#if PY_VERSION_HEX >= 0x030C0000
+        if (!isolated) {
+            return;
+        }
+
+        PyInterpreterConfig config = {};
+
+        config.use_main_obmalloc = 0;
+        config.allow_fork = 0;
+        config.allow_exec = 0;
+        config.allow_threads = 1;
+        config.allow_daemon_threads = 0;
+        config.check_multi_interp_extensions = 1;
+        config.gil = PyInterpreterConfig_OWN_GIL;
+
+        // creating an interpreter requires a current thread state.  the main GIL is released once the new
+        // interpreter's thread state is current
+        auto gil_state = PyGILState_Ensure();
+        auto main_tstate = PyThreadState_Get();
+
+        PyStatus status = Py_NewInterpreterFromConfig(&tstate_, &config);
+
+        if (PyStatus_Exception(status)) {
+            tstate_ = nullptr;
+            PyGILState_Release(gil_state);
+
+            std::string err = "creating python interpreter failed";
+            if (status.err_msg != nullptr) {
+                err.append(": ").append(status.err_msg);
+            }
+            throw std::runtime_error(err);
+        }
+
+        PyEval_SaveThread();
+        PyEval_RestoreThread(main_tstate);
+        PyGILState_Release(gil_state);
+#endif
+    }
+
+    PythonInterpreter::~PythonInterpreter() {
+        if (tstate_ != nullptr) {
+            PyEval_RestoreThread(tstate_);
+            Py_EndInterpreter(tstate_);
+        }
+    }
+
+    PythonInterpreter::Lock::Lock(PythonInterpreter& interpreter) : interpreter_(interpreter) {
+        if (interpreter_.tstate_ != nullptr) {
+            PyEval_RestoreThread(interpreter_.tstate_);
+        } else {
+            gil_state_ = PyGILState_Ensure();
+        }
+    }
+
+    PythonInterpreter::Lock::~Lock() {
+        if (interpreter_.tstate_ != nullptr) {
+            PyEval_SaveThread();
+        } else {
+            PyGILState_Release(static_cast<PyGILState_STATE>(gil_state_));
+        }
+    }
+
+    PythonCall::PythonCall(PythonInterpreter& interpreter, const std::string& script_file, const std::string& func_name) :
+        interpreter_(interpreter) {
+        PythonInterpreter::Lock lock(interpreter_);
         std::filesystem::path path(script_file);
 
         std::string sys_path_cmd("sys.path.append(\"");
@@ -47,6 +120,12 @@ namespace packet_replay
         PyObject* py_module = PyImport_Import(py_module_name);
 
         if (py_module == nullptr) {
+            if (interpreter_.isolated() && PyErr_ExceptionMatches(PyExc_ImportError)) {
+                PyErr_Clear();
+                Py_DECREF(py_module_name);
+                throw PythonImportError("importing python module " + path.stem().string() + " into a sub-interpreter failed");
+            }
+
             PyErr_Print();
             throw std::runtime_error("importing python module failed");
         }
@@ -56,42 +135,169 @@ namespace packet_replay
 
         Py_DECREF(py_module);
         Py_DECREF(py_module_name);
+
+        if (py_func_ == nullptr) {
+            PyErr_Print();
+            throw std::runtime_error("python function " + func_name + " not found");
+        }
     }
 
     PythonCall::~PythonCall() {
         if (py_func_ != nullptr) {
+            PythonInterpreter::Lock lock(interpreter_);
             Py_DECREF(py_func_);
         }
     }
 
+    /**
+     * A read-only view of a packet that does not copy it
+     */
+    static PyObject* packetView(const uint8_t* data, int data_len) {
+        PyObject* view = PyMemoryView_FromMemory(reinterpret_cast<char *>(const_cast<uint8_t *>(data)), data_len, PyBUF_READ);
+
+        if (view == nullptr) {
+            PyErr_Print();
+            throw std::runtime_error("creating python memoryview failed");
+        }
+
+        return view;
+    }
+
+    /**
+     * Release a view so the function cannot read the buffer after the call through a reference it kept
+     */
+    static void releaseView(PyObject* view) {
+        // keep the error raised by the call, if any, for the caller to report
+        PyObject* type;
+        PyObject* value;
+        PyObject* traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+
+        PyObject* result = PyObject_CallMethod(view, "release", nullptr);
+
+        // slices taken from the view stay valid as far as python knows, nothing more can be done about those
+        if (result == nullptr) {
+            PyErr_Clear();
+        } else {
+            Py_DECREF(result);
+        }
+
+        Py_DECREF(view);
+        PyErr_Restore(type, value, traceback);
+    }
+
+    static bool toBool(PyObject* result, const std::string& func_name) {
+        if (!PyBool_Check(result)) {
+            std::string err = "python function ";
+            err.append(func_name).append(" must return bool");
+            throw std::runtime_error(err);
+        }
+
+        return Py_True == result;
+    }
+
     bool ValidatePythonCall::validate(const uint8_t* expected, int expected_len, const uint8_t* actual, int actual_len) {
-        PyObject* args = Py_BuildValue("(y#y#)", expected, expected_len, actual, actual_len);
+        PythonInterpreter::Lock lock(interpreter_);
+        PyObject* expected_view = packetView(expected, expected_len);
+        PyObject* actual_view = packetView(actual, actual_len);
+
+        PyObject* result = PyObject_CallFunctionObjArgs(py_func_, expected_view, actual_view, nullptr);
+
+        releaseView(expected_view);
+        releaseView(actual_view);
+
+        if (result == nullptr) {
+            PyErr_Print();
+            throw std::runtime_error("caling python function failed");
+        }
+
+        bool ret;
+
+        try {
+            ret = toBool(result, func_name_);
+        } catch (...) {
+            Py_DECREF(result);
+            throw;
+        }
+
+        Py_DECREF(result);
+
+        return ret;
+    }
+
+    void ValidatePythonCall::validateBatch(PacketPair* pairs, size_t count) {
+        PythonInterpreter::Lock lock(interpreter_);
+        PyObject* list = PyList_New(count);
+        std::vector<PyObject *> views;
 
-        if (args == nullptr) {
+        if (list == nullptr) {
             PyErr_Print();
             throw std::runtime_error("building python arguments failed");
         }
 
-        PyObject* result = PyObject_CallObject(py_func_, args);
+        views.reserve(count * 2);
+
+        PyObject* result = nullptr;
+
+        try {
+            for (size_t i = 0; i < count; i++) {
+                views.push_back(packetView(pairs[i].expected_, pairs[i].expected_len_));
+                views.push_back(packetView(pairs[i].actual_, pairs[i].actual_len_));
+
+                PyObject* pair = PyTuple_Pack(2, views[i * 2], views[i * 2 + 1]);
+
+                if (pair == nullptr) {
+                    PyErr_Print();
+                    throw std::runtime_error("building python arguments failed");
+                }
+
+                // steals the reference to the tuple
+                PyList_SET_ITEM(list, i, pair);
+            }
+
+            result = PyObject_CallFunctionObjArgs(py_func_, list, nullptr);
+        } catch (...) {
+            for (auto view : views) {
+                releaseView(view);
+            }
+            Py_DECREF(list);
+            throw;
+        }
+
+        for (auto view : views) {
+            releaseView(view);
+        }
+        Py_DECREF(list);
 
         if (result == nullptr) {
             PyErr_Print();
             throw std::runtime_error("caling python function failed");
         }
 
-        Py_DECREF(args);
+        PyObject* seq = PySequence_Fast(result, "");
+        Py_DECREF(result);
+
+        if (seq == nullptr || static_cast<size_t>(PySequence_Fast_GET_SIZE(seq)) != count) {
+            PyErr_Clear();
+            Py_XDECREF(seq);
 
-        if (!PyBool_Check(result)) {
             std::string err = "python function ";
-            err.append(func_name_).append(" must return bool");
+            err.append(func_name_).append(" must return a sequence with a bool for each packet");
             throw std::runtime_error(err);
         }
 
-        bool ret = Py_True == result;
-        Py_DECREF(args);
-        Py_DECREF(result);
+        PyObject** items = PySequence_Fast_ITEMS(seq);
 
-        return ret;
-    }    
+        try {
+            for (size_t i = 0; i < count; i++) {
+                pairs[i].equivalent_ = toBool(items[i], func_name_);
+            }
+        } catch (...) {
+            Py_DECREF(seq);
+            throw;
+        }
+
+        Py_DECREF(seq);
+    }
 } // namespace packet_replay
 
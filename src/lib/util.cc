@@ -16,7 +16,7 @@ namespace packet_replay {
         std::stringstream str_stream(str);
         std::string token;
 
-        while (std::getline(str_stream, token, ':')) {
+        while (std::getline(str_stream, token, delimiter)) {
             tokens.push_back(token);
         }
 
@@ -0,0 +1,200 @@
+#include <stdint.h>
+
+#include <latch>
+#include <mutex>
+#include <stdexcept>
+
+#include "validation_pipeline.h"
+
+namespace packet_replay
+{
+    ValidationPipeline::ValidationPipeline(int threads, size_t capacity, const ValidatorFactory& validator_factory) {
+        size_t size = 1;
+
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        cells_.reset(new Cell[size]);
+        mask_ = size - 1;
+
+        for (size_t i = 0; i < size; i++) {
+            cells_[i].sequence_.store(i, std::memory_order_relaxed);
+        }
+
+        // validators are created on their threads, wait for all of them so a failure is reported here
+        std::latch created(threads);
+        std::mutex mutex;
+        std::exception_ptr error;
+
+        for (int i = 0; i < threads; i++) {
+            threads_.emplace_back([this, &validator_factory, &created, &mutex, &error]() {
+                std::unique_ptr<PacketValidator> validator;
+
+                try {
+                    if (validator_factory) {
+                        validator.reset(validator_factory());
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+
+                created.count_down();
+                run(std::move(validator));
+            });
+        }
+
+        created.wait();
+
+        if (error) {
+            stop_ = true;
+            queued_.release(threads_.size());
+
+            for (auto& thread : threads_) {
+                thread.join();
+            }
+
+            std::rethrow_exception(error);
+        }
+    }
+
+    ValidationPipeline::~ValidationPipeline() {
+        stop_ = true;
+        queued_.release(threads_.size());
+
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    bool ValidationPipeline::push(ValidationJob* job) {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+        while (true) {
+            auto& cell = cells_[pos & mask_];
+            auto sequence = cell.sequence_.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.job_ = job;
+                    cell.sequence_.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // the slot still holds a job from the previous lap, the queue is full
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ValidationJob* ValidationPipeline::pop() {
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+        while (true) {
+            auto& cell = cells_[pos & mask_];
+            auto sequence = cell.sequence_.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    auto job = cell.job_;
+                    cell.sequence_.store(pos + mask_ + 1, std::memory_order_release);
+                    return job;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void ValidationPipeline::submit(ValidationJob* job) {
+        while (!push(job)) {
+            std::this_thread::yield();
+        }
+
+        queued_.release();
+    }
+
+    void ValidationPipeline::run(std::unique_ptr<PacketValidator> validator) {
+        while (true) {
+            queued_.acquire();
+
+            if (stop_) {
+                return;
+            }
+
+            // every release follows a completed push, but with several producers the job at the head of the queue
+            // may be reserved by a producer that has not published it yet while a later one is already counted
+            ValidationJob* job;
+
+            while ((job = pop()) == nullptr) {
+                std::this_thread::yield();
+            }
+
+            try {
+                job->validate(validator.get());
+            } catch (...) {
+                job->error_ = std::current_exception();
+            }
+
+            job->done_.store(true, std::memory_order_release);
+            job->done_.notify_one();
+        }
+    }
+
+    ValidationQueue::ValidationQueue(ValidationPipeline& pipeline, size_t max_outstanding) :
+        pipeline_(pipeline), max_outstanding_(max_outstanding) {
+    }
+
+    ValidationQueue::~ValidationQueue() {
+        // the jobs are owned here, they must not be freed while a validation thread uses them
+        for (auto& job : jobs_) {
+            job->done_.wait(false, std::memory_order_acquire);
+        }
+    }
+
+    void ValidationQueue::reportFront() {
+        auto job = std::move(jobs_.front());
+        jobs_.pop_front();
+
+        if (job->error_) {
+            std::rethrow_exception(job->error_);
+        }
+
+        job->report();
+    }
+
+    void ValidationQueue::submit(std::unique_ptr<ValidationJob> job) {
+        while (jobs_.size() >= max_outstanding_) {
+            jobs_.front()->done_.wait(false, std::memory_order_acquire);
+            reportFront();
+        }
+
+        pipeline_.submit(job.get());
+        jobs_.push_back(std::move(job));
+
+        poll();
+    }
+
+    void ValidationQueue::poll() {
+        while (!jobs_.empty() && jobs_.front()->done_.load(std::memory_order_acquire)) {
+            reportFront();
+        }
+    }
+
+    void ValidationQueue::finish() {
+        while (!jobs_.empty()) {
+            jobs_.front()->done_.wait(false, std::memory_order_acquire);
+            reportFront();
+        }
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Sample native validator plugin with the logic of src/python/dns.py: DNS responses are compared byte by byte except
+ * for the TTLs of the resource records.  Unlike dns.py the TTL of OPT records, which holds EDNS flags, is compared.
+ *
+ * Usage: -k native:<path to libdns_plugin.so>:dns_validator
+ */
+
+#include <string.h>
+
+#include "packet_replay_plugin.h"
+
+#define HEADER_SIZE 12
+#define TYPE_OPT 41
+
+static size_t read16(const uint8_t* data) {
+    return ((size_t) data[0] << 8) | data[1];
+}
+
+/* the offset after the name at offset, or 0 if the name runs past the end */
+static size_t skip_name(const uint8_t* data, size_t len, size_t offset) {
+    while (offset < len) {
+        uint8_t label_len = data[offset];
+
+        if (label_len == 0) {
+            return offset + 1;
+        }
+
+        if (label_len > 63) {
+            /* pointer */
+            return offset + 2 <= len ? offset + 2 : 0;
+        }
+
+        offset += 1 + label_len;
+    }
+
+    return 0;
+}
+
+static int validate(void* context, packet_replay_span expected, packet_replay_span actual) {
+    const uint8_t* data = expected.data;
+    size_t len = expected.len;
+    size_t offset = HEADER_SIZE;
+    size_t start = 0;
+    size_t records;
+    size_t i;
+
+    (void) context;
+
+    if (expected.len != actual.len) {
+        return 0;
+    }
+
+    if (len < HEADER_SIZE) {
+        return memcmp(expected.data, actual.data, len) == 0;
+    }
+
+    for (i = read16(data + 4); i > 0; i--) {
+        offset = skip_name(data, len, offset);
+
+        /* QTYPE + QCLASS */
+        if (offset == 0 || offset + 4 > len) {
+            return memcmp(expected.data, actual.data, len) == 0;
+        }
+        offset += 4;
+    }
+
+    records = read16(data + 6) + read16(data + 8) + read16(data + 10);
+
+    for (i = 0; i < records; i++) {
+        size_t ttl;
+
+        offset = skip_name(data, len, offset);
+
+        /* TYPE + CLASS + TTL + RDLENGTH */
+        if (offset == 0 || offset + 10 > len) {
+            return memcmp(expected.data, actual.data, len) == 0;
+        }
+
+        ttl = offset + 4;
+
+        if (read16(data + offset) != TYPE_OPT) {
+            if (memcmp(data + start, actual.data + start, ttl - start) != 0) {
+                return 0;
+            }
+
+            start = ttl + 4;
+        }
+
+        offset += 10 + read16(data + offset + 8);
+    }
+
+    return memcmp(data + start, actual.data + start, len - start) == 0;
+}
+
+const packet_replay_validator dns_validator = {
+    PACKET_REPLAY_PLUGIN_ABI_VERSION,
+    NULL,
+    NULL,
+    validate
+};
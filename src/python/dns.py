@@ -1,7 +1,7 @@
 import struct
 import io
 
-# DNS packet validation function that avoids comparing the TTLs
+# DNS packet validation function that avoids comparing the TTLs.  The packets are memoryviews
 def validate(expected, actual):
     ttls = []
     reader = io.BytesIO(expected)
@@ -22,6 +22,7 @@ def validate(expected, actual):
         skip_name(reader)
         reader.read(4) # type + class
         ttls.append(reader.tell())
+        reader.read(4) # TTL
         data_len = struct.unpack("!H", reader.read(2))[0]
         reader.read(data_len)
         # TODO: handle OPT records which use TTL for other purposes
@@ -32,8 +33,8 @@ def validate(expected, actual):
     # think this implementation is clearer
     for ttl in ttls:
         if expected[start_idx : ttl] != actual[start_idx : ttl]:
-            print("e:", expected[start_idx : ttl])
-            print("a:", actual[start_idx : ttl])
+            print("e:", bytes(expected[start_idx : ttl]))
+            print("a:", bytes(actual[start_idx : ttl]))
             print("failure", start_idx, ":", ttl)
             return False
 
@@ -41,6 +42,10 @@ def validate(expected, actual):
 
     return expected[start_idx:] == actual[start_idx:]
 
+# batched form of validate, taking a list of (expected, actual) pairs
+def validate_batch(pairs):
+    return [validate(expected, actual) for expected, actual in pairs]
+
 def skip_question(reader):
     skip_name(reader)
     reader.read(4) # QTYPE + QCLASS
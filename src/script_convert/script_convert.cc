@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compression.h"
+#include "conversation_serializer.h"
+#include "payload_store.h"
+
+// the default size of zstd --train
+static const size_t DICTIONARY_SIZE = 112640;
+
+static void printUsage(const char* name) {
+    std::cerr << "Usage: " << name << " [-b | -t] [-p <payload file>] [-z <compression level>] [-Z <dictionary file>] <input script> <output script> [<input script> <output script> ...]" << std::endl;
+    std::cerr << "       " << name << " -T <dictionary file> <script> [<script> ...]" << std::endl;
+}
+
+/**
+ * @return true if the script is a binary script, after decompressing it if it is compressed
+ */
+static bool isBinaryScript(const std::string& file, const packet_replay::CompressionDictionary* dictionary) {
+    char magic[8];
+    auto input = packet_replay::openDecompressed(file, dictionary);
+    auto len = fread(magic, 1, sizeof(magic), input);
+
+    fclose(input);
+
+    return packet_replay::ConversationSerializer::isBinary(magic, len);
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        // without -b or -t a script is converted to the other format
+        bool binary = false;
+        bool text = false;
+        std::string payload_file;
+        std::string dictionary_file;
+        std::string train_file;
+        int level = 0;
+
+        int opt;
+        while ((opt = getopt(argc, argv, "btp:z:Z:T:")) != -1) {
+            switch (opt) {
+                case 'b':
+                    binary = true;
+                    break;
+
+                case 't':
+                    text = true;
+                    break;
+
+                case 'p':
+                    payload_file = optarg;
+                    binary = true;
+                    break;
+
+                case 'z':
+                    level = std::stoi(optarg);
+
+                    if (level == 0) {
+                        throw std::invalid_argument("invalid compression level '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'Z':
+                    dictionary_file = optarg;
+                    break;
+
+                case 'T':
+                    train_file = optarg;
+                    break;
+
+                default:
+                    printUsage(argv[0]);
+                    return -1;
+            }
+        }
+
+        if (!train_file.empty()) {
+            if (optind == argc) {
+                printUsage(argv[0]);
+                return -1;
+            }
+
+            auto size = packet_replay::CompressionDictionary::train(std::vector<std::string>(argv + optind, argv + argc), train_file, DICTIONARY_SIZE);
+
+            std::cerr << "dictionary " << train_file << ": " << size << " bytes" << std::endl;
+            return 0;
+        }
+
+        if (optind == argc || (argc - optind) % 2 != 0 || (binary && text)) {
+            printUsage(argv[0]);
+            return -1;
+        }
+
+        std::unique_ptr<packet_replay::CompressionDictionary> dictionary;
+
+        if (!dictionary_file.empty()) {
+            dictionary = std::make_unique<packet_replay::CompressionDictionary>(dictionary_file);
+        }
+
+        // the payloads of all scripts converted go to one payload file
+        std::unique_ptr<packet_replay::PayloadFileWriter> payloads;
+
+        if (!payload_file.empty()) {
+            payloads = std::make_unique<packet_replay::PayloadFileWriter>(payload_file);
+        }
+
+        for (int i = optind; i < argc; i += 2) {
+            std::string input_file = argv[i];
+            std::string output_file = argv[i + 1];
+
+            packet_replay::ConversationSerializer serializer;
+
+            serializer.setDictionary(dictionary.get());
+
+            auto conversation = serializer.load(input_file);
+            auto to_binary = binary || (!text && !isBinaryScript(input_file, dictionary.get()));
+
+            std::ofstream output(output_file, std::ios::binary);
+
+            if (!output) {
+                throw std::runtime_error("cannot create " + output_file);
+            }
+
+            // scripts to compress are written to memory first, so their size is stored in the compressed frame
+            std::ostringstream uncompressed;
+            std::ostream* script = level != 0 ? static_cast<std::ostream *>(&uncompressed) : &output;
+
+            if (payloads) {
+                // scripts refer to the payload file relative to their own directory
+                auto dir = std::filesystem::absolute(output_file).parent_path();
+                auto name = std::filesystem::relative(std::filesystem::absolute(payload_file), dir).string();
+
+                serializer.writeBinary(*script, conversation.get(), *payloads, name);
+            } else if (to_binary) {
+                serializer.writeBinary(*script, conversation.get());
+            } else {
+                serializer.write(*script, conversation.get());
+            }
+
+            if (level != 0) {
+                auto data = std::move(uncompressed).str();
+                packet_replay::CompressedOutputBuffer buffer(output, level, dictionary.get(), data.size());
+
+                buffer.sputn(data.data(), data.size());
+                buffer.finish();
+            }
+
+            output.close();
+
+            if (!output) {
+                throw std::runtime_error("cannot write " + output_file);
+            }
+        }
+
+        if (payloads) {
+            std::cerr << "payload file " << payload_file << ": " << payloads->size() << " bytes" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
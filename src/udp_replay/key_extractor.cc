@@ -0,0 +1,112 @@
+#include <string.h>
+#include <strings.h>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "key_extractor.h"
+#include "util.h"
+
+namespace packet_replay {
+    static const int DNS_HEADER_SIZE = 12;
+
+    static uint64_t hashBytes(uint64_t h, std::string_view data) {
+        // FNV-1a
+        for (auto c : data) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 0x100000001b3ULL;
+        }
+
+        return h;
+    }
+
+    static bool isHeader(std::string_view line, std::string_view name) {
+        return line.size() > name.size() && strncasecmp(line.data(), name.data(), name.size()) == 0 &&
+            (line[name.size()] == ':' || line[name.size()] == ' ' || line[name.size()] == '\t');
+    }
+
+    static std::string_view headerValue(std::string_view line) {
+        auto value = line.substr(line.find(':') + 1);
+
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+            value.remove_prefix(1);
+        }
+
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t' || value.back() == '\r')) {
+            value.remove_suffix(1);
+        }
+
+        return value;
+    }
+
+    KeyExtractor* KeyExtractor::create(const std::string& name) {
+        std::string lower_name = name;
+        toLower(lower_name);
+
+        if (lower_name == "dns") {
+            return new DnsKeyExtractor();
+        } else if (lower_name == "sip") {
+            return new SipKeyExtractor();
+        }
+
+        throw std::invalid_argument("invalid key extractor '" + name + "'");
+    }
+
+    bool DnsKeyExtractor::extract(const uint8_t* data, int data_len, uint64_t& key) const {
+        if (data_len < DNS_HEADER_SIZE) {
+            return false;
+        }
+
+        key = (data[0] << 8) | data[1];
+
+        return true;
+    }
+
+    bool DnsKeyExtractor::replace(uint8_t* data, int data_len, uint64_t key) const {
+        if (data_len < DNS_HEADER_SIZE) {
+            return false;
+        }
+
+        data[0] = key >> 8;
+        data[1] = key;
+
+        return true;
+    }
+
+    bool SipKeyExtractor::extract(const uint8_t* data, int data_len, uint64_t& key) const {
+        std::string_view message(reinterpret_cast<const char *>(data), data_len);
+        std::string_view call_id;
+        std::string_view cseq;
+
+        // skip the request or status line
+        auto pos = message.find('\n');
+
+        while (pos != std::string_view::npos && pos + 1 < message.size()) {
+            auto start = pos + 1;
+            pos = message.find('\n', start);
+
+            auto line = message.substr(start, pos == std::string_view::npos ? std::string_view::npos : pos - start);
+
+            if (line.empty() || line == "\r") {
+                // end of the headers
+                break;
+            }
+
+            // "i" is the compact form of Call-ID
+            if (isHeader(line, "Call-ID") || isHeader(line, "i")) {
+                call_id = headerValue(line);
+            } else if (isHeader(line, "CSeq")) {
+                cseq = headerValue(line);
+            }
+        }
+
+        if (call_id.empty() || cseq.empty()) {
+            return false;
+        }
+
+        key = hashBytes(hashBytes(0xcbf29ce484222325ULL, call_id), cseq);
+
+        return true;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PACKET_REPLAY_KEY_EXTRACTOR_H
+#define PACKET_REPLAY_KEY_EXTRACTOR_H
+
+#include <stdint.h>
+
+#include <string>
+
+namespace packet_replay {
+    /**
+     * Extracts the key that matches a response datagram to its request, used to pair responses with the expected
+     * responses when several requests are outstanding.
+     */
+    class KeyExtractor {
+        public:
+            virtual ~KeyExtractor() {}
+
+            /**
+             * @param key set to the key of the datagram
+             *
+             * @return false if the datagram does not have a key
+             */
+            virtual bool extract(const uint8_t* data, int data_len, uint64_t& key) const = 0;
+
+            /**
+             * The number of distinct keys that replace can write, 0 if keys cannot be replaced
+             */
+            virtual uint64_t keySpace() const {
+                return 0;
+            }
+
+            /**
+             * Replace the key of a datagram.  Used to give concurrent requests unique keys.
+             *
+             * @return false if the datagram does not have a key
+             */
+            virtual bool replace(uint8_t*, int, uint64_t) const {
+                return false;
+            }
+
+            /**
+             * Create an extractor by name: "dns" or "sip".  Throws std::invalid_argument for an unknown name.
+             */
+            static KeyExtractor* create(const std::string& name);
+    };
+
+    /**
+     * The DNS transaction ID
+     */
+    class DnsKeyExtractor : public KeyExtractor {
+        public:
+            bool extract(const uint8_t* data, int data_len, uint64_t& key) const override;
+
+            uint64_t keySpace() const override {
+                return 0x10000;
+            }
+
+            bool replace(uint8_t* data, int data_len, uint64_t key) const override;
+    };
+
+    /**
+     * The SIP Call-ID and CSeq headers.  Responses repeat both headers of the request.
+     */
+    class SipKeyExtractor : public KeyExtractor {
+        public:
+            bool extract(const uint8_t* data, int data_len, uint64_t& key) const override;
+    };
+}
+
+#endif
@@ -1,95 +1,655 @@
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <exception>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "action.h"
+#include "compression.h"
+#include "dns_validator.h"
+#include "mask_validator.h"
+#include "native_validator.h"
+#include "payload_store.h"
 #include "udp_replay.h"
 #include "udp_conversation.h"
 #include "python_api.h"
 #include "util.h"
 
 namespace packet_replay {
-    UdpReplayClient::UdpReplayClient(UdpConversation* conversation, PacketValidator* validator) : conversation_(conversation), validator_(validator) {
+    // the kernel limits on one UDP_SEGMENT send
+    static const size_t GSO_MAX_SEGMENTS = 64;
+    static const size_t GSO_MAX_BYTES = 65507;
+
+    UdpReplayClient::UdpReplayClient(UdpConversation* conversation, PacketValidator* validator, const UdpReplayOptions& options, DatagramBuffers& buffers) :
+        conversation_(conversation), validator_(validator), options_(options), buffers_(buffers) {
+        if (options.validation_pipeline_) {
+            validation_queue_.reset(new ValidationQueue(*options.validation_pipeline_, options.validation_pipeline_->capacity()));
+        }
+
         socket_ = socket(conversation->getAddressFamily(), SOCK_DGRAM, 0);
         if (socket_ < 0) {
             throw std::runtime_error("socket failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
         }
+
+        if (options.offload_) {
+            int on = 1;
+
+            if (setsockopt(socket_, SOL_UDP, UDP_GRO, &on, sizeof(on)) != 0) {
+                throw std::runtime_error("setsockopt UDP_GRO failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+            }
+        }
     }
 
-    void UdpReplayClient::replay() {
-        while (!conversation_->actionEmpty()) {
-            auto action = conversation_->actionFront();
+    size_t UdpReplayClient::countActions(Action::Type type, size_t max) {
+        size_t count = 0;
+
+        while (count < max && count < conversation_->actionSize() && conversation_->actionAt(count)->type_ == type) {
+            count++;
+        }
 
-            switch (action->type_) {
-                case Action::Type::SEND: {
-                    auto data = action->data();
-                    auto nwrite = sendto(socket_, data.data(), data.size(), 0, (const sockaddr*) conversation_->getTestSockAddr(), conversation_->getSockAddrSize());
+        return count;
+    }
 
-                    if (nwrite < 0) {
-                        throw std::runtime_error("sendto failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
-                    }
-                    break;
+    size_t UdpReplayClient::gsoRunLength(size_t start, size_t count) {
+        auto& actions = buffers_.send_actions_;
+        size_t segment_size = actions[start]->data().size();
+        size_t total = segment_size;
+        size_t end = start + 1;
+
+        if (segment_size == 0) {
+            return 1;
+        }
+
+        while (end < count && end - start < GSO_MAX_SEGMENTS) {
+            auto size = actions[end]->data().size();
+
+            if (size == 0 || size > segment_size || total + size > GSO_MAX_BYTES) {
+                break;
+            }
+
+            total += size;
+            end++;
+
+            // only the last segment can be shorter
+            if (size < segment_size) {
+                break;
+            }
+        }
+
+        return end - start;
+    }
+
+    void UdpReplayClient::sendBatch() {
+        auto msgs = buffers_.msgs_.data();
+        auto iovs = buffers_.iovs_.data();
+        auto& actions = buffers_.send_actions_;
+        auto count = actions.size();
+
+        for (size_t i = 0; i < count; i++) {
+            auto& data = actions[i]->data();
+
+            iovs[i].iov_base = const_cast<char *>(data.data());
+            iovs[i].iov_len = data.size();
+        }
+
+        size_t nmsgs = 0;
+
+        for (size_t i = 0; i < count; nmsgs++) {
+            auto run = options_.offload_ ? gsoRunLength(i, count) : 1;
+
+            memset(&msgs[nmsgs], 0, sizeof(msgs[nmsgs]));
+            msgs[nmsgs].msg_hdr.msg_name = conversation_->getTestSockAddr();
+            msgs[nmsgs].msg_hdr.msg_namelen = conversation_->getSockAddrSize();
+            msgs[nmsgs].msg_hdr.msg_iov = &iovs[i];
+            msgs[nmsgs].msg_hdr.msg_iovlen = run;
+
+            if (run > 1) {
+                // the kernel splits the payload into datagrams of the segment size
+                auto control = buffers_.control(nmsgs);
+
+                msgs[nmsgs].msg_hdr.msg_control = control;
+                msgs[nmsgs].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+                auto cmsg = CMSG_FIRSTHDR(&msgs[nmsgs].msg_hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+                uint16_t segment_size = iovs[i].iov_len;
+                memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+            }
+
+            i += run;
+        }
+
+        size_t nsent = 0;
+
+        while (nsent < nmsgs) {
+            auto n = sendmmsg(socket_, msgs + nsent, nmsgs - nsent, 0);
+
+            if (n < 0) {
+                throw std::runtime_error("sendmmsg failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+            }
+
+            nsent += n;
+        }
+
+        sent_ += count;
+    }
+
+    bool UdpReplayClient::fromServer(const struct sockaddr_storage& addr) const {
+        auto server = static_cast<const struct sockaddr *>(conversation_->getTestSockAddr());
+
+        if (addr.ss_family != server->sa_family) {
+            return false;
+        }
+
+        if (addr.ss_family == AF_INET) {
+            auto addr4 = reinterpret_cast<const struct sockaddr_in *>(&addr);
+            auto server4 = reinterpret_cast<const struct sockaddr_in *>(server);
+
+            return addr4->sin_port == server4->sin_port && addr4->sin_addr.s_addr == server4->sin_addr.s_addr;
+        } else if (addr.ss_family == AF_INET6) {
+            auto addr6 = reinterpret_cast<const struct sockaddr_in6 *>(&addr);
+            auto server6 = reinterpret_cast<const struct sockaddr_in6 *>(server);
+
+            return addr6->sin6_port == server6->sin6_port && memcmp(&addr6->sin6_addr, &server6->sin6_addr, sizeof(addr6->sin6_addr)) == 0;
+        }
+
+        return true;
+    }
+
+    int UdpReplayClient::receiveMessages(size_t slot, size_t count, int flags) {
+        auto msgs = buffers_.msgs_.data();
+        auto iovs = buffers_.iovs_.data();
+        auto& datagrams = buffers_.datagrams_;
+
+        for (size_t i = slot; i < slot + count; i++) {
+            iovs[i].iov_base = buffers_.recvBuffer(i);
+            iovs[i].iov_len = buffers_.recv_buf_size_;
+
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_name = &buffers_.names_[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(buffers_.names_[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+
+            if (options_.offload_) {
+                msgs[i].msg_hdr.msg_control = buffers_.control(i);
+                msgs[i].msg_hdr.msg_controllen = DatagramBuffers::CONTROL_SIZE;
+            }
+        }
+
+        auto n = recvmmsg(socket_, msgs + slot, count, flags, nullptr);
+
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+
+            throw std::runtime_error("recvmmsg failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+        }
+
+        int used = 0;
+
+        for (auto i = slot; i < slot + n; i++) {
+            if (!fromServer(buffers_.names_[i])) {
+                unexpected_++;
+                continue;
+            }
+
+            int len = msgs[i].msg_len;
+            int segment_size = len;
+
+            // the comparison of a truncated datagram fails, say why
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                std::cout << "server response truncated to the receive buffer size of " << len << " bytes" << std::endl;
+                truncated_++;
+            }
+
+            for (auto cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                    memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+                }
+            }
+
+            auto data = buffers_.recvBuffer(i);
+
+            if (len == 0 || segment_size <= 0) {
+                datagrams.emplace_back(data, len);
+            } else {
+                for (int offset = 0; offset < len; offset += segment_size) {
+                    datagrams.emplace_back(data + offset, std::min(segment_size, len - offset));
                 }
+            }
+
+            used = i - slot + 1;
+        }
+
+        return used;
+    }
+
+    void UdpReplayClient::recvBatch(size_t count) {
+        auto& datagrams = buffers_.datagrams_;
+
+        datagrams.clear();
+
+        // datagrams received with the previous batch
+        while (datagrams.size() < count && spill_idx_ < spill_lens_.size()) {
+            datagrams.emplace_back(spill_.data() + spill_pos_, spill_lens_[spill_idx_]);
+            spill_pos_ += spill_lens_[spill_idx_++];
+        }
+
+        // every message from the server holds at least one datagram, so only datagrams from other sources can use up
+        // the slots before the batch is complete
+        size_t slot = 0;
+
+        while (datagrams.size() < count) {
+            auto nmsgs = std::min(count - datagrams.size(), buffers_.batch_size_ - slot);
+
+            if (nmsgs == 0) {
+                throw std::runtime_error("receive buffers exhausted by datagrams from other sources");
+            }
 
-                case Action::Type::RECV: {
-                    // TODO: set configurable buffer size
-                    auto data_size = action->data().size() + 1024;
+            // block for the first datagram, then take whatever else has already arrived
+            slot += receiveMessages(slot, nmsgs, MSG_WAITFORONE);
+        }
+
+        received_ += count;
+
+        auto& pairs = buffers_.pairs_;
+
+        pairs.clear();
+
+        for (size_t i = 0; i < count; i++) {
+            auto& expected = conversation_->actionAt(i)->data();
+
+            pairs.push_back(PacketPair{reinterpret_cast<const uint8_t *>(expected.data()), static_cast<int>(expected.size()),
+                datagrams[i].first, datagrams[i].second, false});
+        }
+
+        validatePairs();
+
+        if (datagrams.size() > count) {
+            // only a receive can coalesce past the end of the batch, so the previous spill has been consumed
+            spill_.clear();
+            spill_lens_.clear();
+            spill_pos_ = 0;
+            spill_idx_ = 0;
 
-                    uint8_t* data = new uint8_t[data_size];
+            for (auto i = count; i < datagrams.size(); i++) {
+                spill_.insert(spill_.cend(), datagrams[i].first, datagrams[i].first + datagrams[i].second);
+                spill_lens_.push_back(datagrams[i].second);
+            }
+        }
+    }
+
+    void UdpValidationJob::validate(PacketValidator* validator) {
+        validator->validate(pairs_.data(), pairs_.size());
+    }
+
+    void UdpValidationJob::report() {
+        for (auto& pair : pairs_) {
+            if (!pair.equivalent_) {
+                std::cout << "detected difference in server response" << std::endl;
+            }
+        }
+    }
 
-                    // TODO: verify message is really from server
-                    auto nread = recvfrom(socket_, data, data_size, 0, nullptr, nullptr);
+    void UdpReplayClient::validatePairs() {
+        auto& pairs = buffers_.pairs_;
+
+        if (validation_queue_) {
+            // the buffers are reused by the next receive, so the job gets a copy of the packets
+            std::unique_ptr<UdpValidationJob> job(new UdpValidationJob());
+            size_t size = 0;
+
+            for (auto& pair : pairs) {
+                size += pair.expected_len_ + pair.actual_len_;
+            }
+
+            job->data_.reset(new uint8_t[size]);
+            job->pairs_.reserve(pairs.size());
+
+            auto ptr = job->data_.get();
+
+            for (auto& pair : pairs) {
+                auto expected = ptr;
+                memcpy(expected, pair.expected_, pair.expected_len_);
+                ptr += pair.expected_len_;
+
+                auto actual = ptr;
+                memcpy(actual, pair.actual_, pair.actual_len_);
+                ptr += pair.actual_len_;
+
+                job->pairs_.push_back(PacketPair{expected, pair.expected_len_, actual, pair.actual_len_, false});
+            }
+
+            validation_queue_->submit(std::move(job));
+            return;
+        }
+
+        validator_->validate(pairs.data(), pairs.size());
+
+        for (auto& pair : pairs) {
+            if (!pair.equivalent_) {
+                std::cout << "detected difference in server response" << std::endl;
+            }
+        }
+    }
+
+    bool UdpReplayClient::keyOf(const uint8_t* data, int data_len, uint64_t& key) const {
+        // without an extractor no datagram has a key, they are all matched in order
+        return options_.key_extractor_ && options_.key_extractor_->extract(data, data_len, key);
+    }
+
+    bool UdpReplayClient::allocateKey(uint64_t& key) {
+        auto key_space = options_.key_extractor_->keySpace();
+
+        for (uint64_t i = 0; i < key_space; i++) {
+            key = next_key_++ % key_space;
+
+            if (outstanding_keys_.find(key) == outstanding_keys_.end()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void UdpReplayClient::removeOutstanding(bool keyed, uint64_t key) {
+        // the oldest response with the key, older ones have been matched or expired already
+        if (!keyed) {
+            keyless_.pop_front();
+            return;
+        }
+
+        auto it = outstanding_keys_.find(key);
+
+        it->second.pop_front();
+        if (it->second.empty()) {
+            outstanding_keys_.erase(it);
+        }
+    }
+
+    void UdpReplayClient::matchResponse(uint8_t* data, int data_len) {
+        received_++;
+
+        uint64_t key;
+        bool keyed = keyOf(data, data_len, key);
+        const std::deque<uint64_t>* waiting = &keyless_;
+
+        if (keyed) {
+            auto it = outstanding_keys_.find(key);
+            waiting = it == outstanding_keys_.end() ? nullptr : &it->second;
+        }
 
-                    if (nread < 0) {
-                        delete[] data;
-                        throw std::runtime_error("recvfrom failed: " + std::string(strerror(errno)) + " (" + std::to_string(errno) + ")");
+        if (waiting == nullptr || waiting->empty()) {
+            unexpected_++;
+            return;
+        }
+
+        // the oldest outstanding response with the key
+        auto& entry = outstanding_[waiting->front() - outstanding_base_];
+        auto& expected = entry.expected_->data();
+
+        if (entry.rewritten_) {
+            options_.key_extractor_->replace(data, data_len, entry.captured_key_);
+        }
+
+        // validated with the other responses of the receive batch
+        buffers_.pairs_.push_back(PacketPair{reinterpret_cast<const uint8_t *>(expected.data()), static_cast<int>(expected.size()),
+            data, data_len, false});
+        validated_.push_back(std::move(entry.expected_));
+        open_--;
+        matched_++;
+
+        removeOutstanding(keyed, key);
+    }
+
+    void UdpReplayClient::expireOutstanding() {
+        auto now = std::chrono::steady_clock::now();
+
+        // deadlines are in send order, so expired responses are always at the front
+        while (!outstanding_.empty() && (!outstanding_.front().expected_ || outstanding_.front().deadline_ <= now)) {
+            auto& entry = outstanding_.front();
+
+            if (entry.expected_) {
+                removeOutstanding(entry.keyed_, entry.key_);
+
+                std::cout << "no server response within " << options_.timeout_ms_ << "ms" << std::endl;
+                open_--;
+                lost_++;
+            }
+
+            outstanding_.pop_front();
+            outstanding_base_++;
+        }
+    }
+
+    void UdpReplayClient::replayWindowed() {
+        auto& send_actions = buffers_.send_actions_;
+        std::vector<std::unique_ptr<Action>> sends;
+        auto timeout = std::chrono::milliseconds(options_.timeout_ms_);
+        bool rewrite = options_.key_extractor_ && options_.key_extractor_->keySpace() > 0;
+
+        while (!conversation_->actionEmpty() || open_ > 0) {
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+
+            // send requests while there is room in the window.  the responses captured after a request are expected
+            // for that request
+            while (!conversation_->actionEmpty() && static_cast<int>(open_) < options_.window_ && static_cast<int>(sends.size()) < buffers_.batch_size_) {
+                bool rewritten = false;
+                uint64_t captured_key;
+                uint64_t key;
+
+                if (conversation_->actionFront()->type_ == Action::Type::SEND) {
+                    auto& data = conversation_->actionFront()->data();
+
+                    if (rewrite && options_.key_extractor_->extract(reinterpret_cast<const uint8_t *>(data.data()), data.size(), captured_key)) {
+                        if (!allocateKey(key)) {
+                            // every key is in use, wait for responses
+                            break;
+                        }
+
+                        // shared data is only copied when it is rewritten
+                        auto& rewrite_data = conversation_->actionFront()->mutableData();
+
+                        rewritten = options_.key_extractor_->replace(reinterpret_cast<uint8_t *>(rewrite_data.data()), rewrite_data.size(), key);
                     }
 
-                    if (!validator_->validate(reinterpret_cast<const uint8_t *>(action->data().data()), action->data().size(), data, nread)) {
-                        std::cout << "detected difference in server response" << std::endl;
+                    sends.emplace_back(conversation_->actionRelease());
+                }
+
+                // the responses must be expected before the request is sent, or a fast response finds no match
+                while (!conversation_->actionEmpty() && conversation_->actionFront()->type_ != Action::Type::SEND) {
+                    std::unique_ptr<Action> action(conversation_->actionRelease());
+
+                    if (action->type_ == Action::Type::RECV) {
+                        auto& expected = action->data();
+                        uint64_t expected_key = 0;
+                        bool keyed = keyOf(reinterpret_cast<const uint8_t *>(expected.data()), expected.size(), expected_key);
+                        bool response_rewritten = rewritten && keyed && expected_key == captured_key;
+                        auto match_key = response_rewritten ? key : expected_key;
+
+                        (keyed ? outstanding_keys_[match_key] : keyless_).push_back(outstanding_base_ + outstanding_.size());
+                        outstanding_.push_back(Outstanding{std::move(action), deadline, match_key, expected_key, response_rewritten, keyed});
+                        open_++;
                     }
+                }
+            }
 
-                    delete[] data;
+            if (!sends.empty()) {
+                send_actions.clear();
 
-                    break;
+                for (auto& action : sends) {
+                    send_actions.push_back(action.get());
                 }
+
+                sendBatch();
+                sends.clear();
             }
 
-            conversation_->actionPop();
+            // wait for responses only when no more requests can be sent
+            int wait_ms = 0;
+
+            if (open_ > 0 && (conversation_->actionEmpty() || static_cast<int>(open_) >= options_.window_)) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(outstanding_.front().deadline_ - std::chrono::steady_clock::now());
+                wait_ms = std::max(static_cast<int>(remaining.count()) + 1, 0);
+            }
+
+            struct pollfd pfd = { socket_, POLLIN, 0 };
+
+            if (poll(&pfd, 1, wait_ms) > 0) {
+                buffers_.datagrams_.clear();
+                buffers_.pairs_.clear();
+                receiveMessages(0, buffers_.batch_size_, MSG_DONTWAIT);
+
+                for (auto& datagram : buffers_.datagrams_) {
+                    matchResponse(datagram.first, datagram.second);
+                }
 
+                validatePairs();
+                validated_.clear();
+            }
+
+            expireOutstanding();
+        }
+    }
+
+    void UdpReplayClient::replay() {
+        if (options_.window_ > 0) {
+            replayWindowed();
+
+            if (validation_queue_) {
+                validation_queue_->finish();
+            }
+            return;
+        }
+
+        auto& send_actions = buffers_.send_actions_;
+
+        while (!conversation_->actionEmpty()) {
+            auto type = conversation_->actionFront()->type_;
+            auto count = countActions(type, buffers_.batch_size_);
+
+            switch (type) {
+                case Action::Type::SEND:
+                    send_actions.clear();
+
+                    for (size_t i = 0; i < count; i++) {
+                        send_actions.push_back(conversation_->actionAt(i));
+                    }
+
+                    sendBatch();
+                    break;
+
+                case Action::Type::RECV:
+                    recvBatch(count);
+                    break;
+
+                default:
+                    break;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                conversation_->actionPop();
+            }
+        }
+
+        if (validation_queue_) {
+            validation_queue_->finish();
         }
     }
 }
 
 static void printUsage(const char* name) {
-    std::cerr << "Usage: " << name << "[-c <client spec>] [-k <packet validator spec>] <cap file>" << std::endl;
+    std::cerr << "Usage: " << name << "[-c <client spec>] [-k <packet validator spec>] [-b <batch size>] [-r <receive buffer size>] [-g] [-w <window> [-m <key extractor>] [-o <timeout ms>]] [-n <threads>] [-a <validation threads>] [-d] [-z <dictionary file>] <cap file>" << std::endl;
 }
 
-static packet_replay::PacketValidator* parseValidator(const char * spec) {
+// the number of receive batches queued for asynchronous validation
+static const size_t VALIDATION_QUEUE_SIZE = 1024;
+
+static packet_replay::ValidatorFactory parseValidator(const char * spec, int validator_threads) {
     std::vector<std::string> tokens = packet_replay::tokenize(spec, ':');
 
     std::string err = "invalid validator spec '";
     err.append(spec).append("'");
 
-    if (tokens.size() != 3) {
+    if (tokens.empty()) {
         throw std::invalid_argument(err);
     }
 
     std::string type_token = tokens[0];
     packet_replay::toLower(type_token);
 
-    if (type_token != "python") {
+    if (type_token == "dns" && tokens.size() <= 2) {
+        std::string options = tokens.size() == 2 ? tokens[1] : "";
+
+        // fail on invalid options before any thread starts
+        packet_replay::DnsPacketValidator validator(options);
+
+        return [options]() {
+            return new packet_replay::DnsPacketValidator(options);
+        };
+    }
+
+    if (type_token == "mask" && tokens.size() == 2) {
+        std::string rules = tokens[1];
+
+        // fail on invalid rules before any thread starts
+        packet_replay::MaskPacketValidator validator(rules);
+
+        return [rules]() {
+            return new packet_replay::MaskPacketValidator(rules);
+        };
+    }
+
+    if (type_token == "native" && (tokens.size() == 3 || tokens.size() == 4)) {
+        std::string library = tokens[1];
+        std::string symbol = tokens[2];
+        std::string options = tokens.size() == 4 ? tokens[3] : "";
+
+        // fail on a missing library or invalid options before any thread starts
+        packet_replay::NativePacketValidator validator(library, symbol, options);
+
+        return [library, symbol, options]() {
+            return new packet_replay::NativePacketValidator(library, symbol, options);
+        };
+    }
+
+    if ((type_token != "python" && type_token != "python-batch") || tokens.size() != 3) {
         throw std::invalid_argument(err);
     }
 
-    return new packet_replay::PythonPacketValidator(tokens[1], tokens[2]);
+    // Python is initialized before the threads start.  with several validator threads each thread imports the
+    // module into its own interpreter, a single thread uses the main interpreter so any extension module imports
+    packet_replay::PythonApi::getInstance();
+
+    std::string python_file = tokens[1];
+    std::string python_func = tokens[2];
+    bool batch = type_token == "python-batch";
+    bool isolated = validator_threads > 1;
+
+    return [python_file, python_func, batch, isolated]() {
+        return new packet_replay::PythonPacketValidator(python_file, python_func, batch, isolated);
+    };
 }
 
 int main(int argc, char* argv[]) {
@@ -97,10 +657,24 @@ int main(int argc, char* argv[]) {
         packet_replay::UdpConversationFactory factory;
         packet_replay::TypedConversationStore<packet_replay::UdpConversation> store(factory);
 
-        packet_replay::PacketValidator* validator = new packet_replay::PacketValidator();
+        packet_replay::UdpReplayOptions options;
+        packet_replay::ValidatorFactory validator_factory = []() {
+            return new packet_replay::PacketValidator();
+        };
+        int threads = 1;
+        int validation_threads = 0;
+
+        // parsed once the number of threads creating validators is known
+        const char* validator_spec = nullptr;
+
+        // set to keep each distinct datagram payload in memory once
+        std::unique_ptr<packet_replay::PayloadStore> payloads;
+
+        // the dictionary a compressed capture was compressed with
+        std::unique_ptr<packet_replay::CompressionDictionary> dictionary;
 
         int opt;
-        while((opt = getopt(argc, argv, "c:k:")) != -1) {  
+        while((opt = getopt(argc, argv, "c:k:b:r:gw:m:o:n:a:dz:")) != -1) {  
             switch(opt)  
             {  
                 case 'c':  
@@ -108,7 +682,71 @@ int main(int argc, char* argv[]) {
                     break;  
 
                 case 'k':
-                    validator = parseValidator(optarg);
+                    validator_spec = optarg;
+                    break;
+
+                case 'b':
+                    options.batch_size_ = std::stoi(optarg);
+
+                    if (options.batch_size_ < 1 || options.batch_size_ > UIO_MAXIOV) {
+                        throw std::invalid_argument("invalid batch size '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'r':
+                    options.recv_buf_size_ = std::stoi(optarg);
+
+                    if (options.recv_buf_size_ < 1) {
+                        throw std::invalid_argument("invalid receive buffer size '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'g':
+                    options.offload_ = true;
+                    break;
+
+                case 'w':
+                    options.window_ = std::stoi(optarg);
+
+                    if (options.window_ < 1) {
+                        throw std::invalid_argument("invalid window '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'm':
+                    options.key_extractor_.reset(packet_replay::KeyExtractor::create(optarg));
+                    break;
+
+                case 'o':
+                    options.timeout_ms_ = std::stoi(optarg);
+
+                    if (options.timeout_ms_ < 0) {
+                        throw std::invalid_argument("invalid timeout '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'n':
+                    threads = std::stoi(optarg);
+
+                    if (threads < 1) {
+                        throw std::invalid_argument("invalid number of threads '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'a':
+                    validation_threads = std::stoi(optarg);
+
+                    if (validation_threads < 1) {
+                        throw std::invalid_argument("invalid number of validation threads '" + std::string(optarg) + "'");
+                    }
+                    break;
+
+                case 'd':
+                    payloads.reset(new packet_replay::PayloadStore());
+                    break;
+
+                case 'z':
+                    dictionary.reset(new packet_replay::CompressionDictionary(optarg));
                     break;
 
                 default:
@@ -122,18 +760,108 @@ int main(int argc, char* argv[]) {
             return -1;
         }
 
+        if (validator_spec != nullptr) {
+            validator_factory = parseValidator(validator_spec, validation_threads > 0 ? validation_threads : threads);
+        }
+
+        if (validation_threads > 0) {
+            options.validation_pipeline_.reset(new packet_replay::ValidationPipeline(validation_threads, VALIDATION_QUEUE_SIZE, validator_factory));
+        }
+
         packet_replay::Capture capture(store);
 
+        capture.setDictionary(dictionary.get());
+
         // store.addConfiguredConversation("127.0.0.1:63596");
         // store.addConfiguredConversation("192.168.1.72:64501");
         // store.addConfiguredConversation("127.0.0.1");
 
         capture.load(argv[optind]);
 
-        for (auto conv : store.getConversations()) {
-            packet_replay::UdpReplayClient client(conv, validator);
+        auto conversations = store.getConversations();
+
+        if (payloads) {
+            for (auto conv : conversations) {
+                for (auto action : conv->getActionQueue()) {
+                    payloads->intern(*action);
+                }
+            }
+
+            std::cerr << "distinct payloads: " << payloads->payloads() << ", bytes stored: " << payloads->bytes()
+                << " of " << payloads->internedBytes() << std::endl;
+        }
+
+        std::atomic<size_t> next_conversation(0);
+        std::mutex mutex;
+        std::exception_ptr error;
+        size_t sent = 0;
+        size_t received = 0;
+        size_t matched = 0;
+        size_t lost = 0;
+        size_t unexpected = 0;
+        size_t truncated = 0;
+
+        // each thread replays whole conversations with its own buffers and validator
+        auto worker = [&]() {
+            try {
+                packet_replay::DatagramBuffers buffers(options);
+                std::unique_ptr<packet_replay::PacketValidator> validator(options.validation_pipeline_ ? nullptr : validator_factory());
+
+                for (size_t i = next_conversation++; i < conversations.size(); i = next_conversation++) {
+                    packet_replay::UdpReplayClient client(conversations[i], validator.get(), options, buffers);
+
+                    client.replay();
+
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    sent += client.sent();
+                    received += client.received();
+                    matched += client.matched();
+                    lost += client.lost();
+                    unexpected += client.unexpected();
+                    truncated += client.truncated();
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (!error) {
+                    error = std::current_exception();
+                }
+
+                // stop the other threads after their current conversation
+                next_conversation = conversations.size();
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> workers;
+
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back(worker);
+        }
+
+        for (auto& thread : workers) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        auto rate = elapsed.count() > 0 ? static_cast<uint64_t>((sent + received) / elapsed.count()) : 0;
+
+        std::cerr << "sent " << sent << " datagrams, received " << received << " datagrams in " << elapsed.count() << "s ("
+            << rate << " datagrams/sec)" << std::endl;
+
+        if (truncated > 0) {
+            std::cerr << "datagrams truncated: " << truncated << ", increase the receive buffer size with -r" << std::endl;
+        }
 
-            client.replay();
+        if (options.window_ > 0) {
+            std::cerr << "responses matched: " << matched << ", lost: " << lost << ", unexpected: " << unexpected << std::endl;
         }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -3,41 +3,248 @@
 
 #include <unistd.h>
 
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "capture.h"
+#include "key_extractor.h"
 #include "packet_validator.h"
 #include "udp_conversation.h"
+#include "validation_pipeline.h"
 
 namespace packet_replay {
     /**
-     * A HTTP client used to replay a conversation
+     * Options that control how conversations are replayed
+     */
+    class UdpReplayOptions {
+        public:
+            // the maximum number of datagrams sent or received with one system call
+            int batch_size_ = 1;
+
+            // the size of the buffer for each received datagram.  larger datagrams are truncated
+            int recv_buf_size_ = 64 * 1024;
+
+            // send runs of equal sized datagrams as one UDP_SEGMENT (GSO) send and receive coalesced datagrams with
+            // UDP_GRO
+            bool offload_ = false;
+
+            // the maximum number of expected responses outstanding.  0 replays the conversation in order, waiting for
+            // each response before sending the next request
+            int window_ = 0;
+
+            // how long to wait for a response in windowed mode before it is counted as lost
+            int timeout_ms_ = 1000;
+
+            // matches responses to expected responses in windowed mode.  responses are matched in the order they
+            // arrive when not set
+            std::unique_ptr<KeyExtractor> key_extractor_;
+
+            // validate responses on these threads instead of the replay thread when set
+            std::unique_ptr<ValidationPipeline> validation_pipeline_;
+    };
+
+    /**
+     * Received datagrams and their expected responses validated on a validation thread
+     */
+    class UdpValidationJob : public ValidationJob {
+        public:
+            // the expected and actual datagrams the pairs point to
+            std::unique_ptr<uint8_t[]> data_;
+            std::vector<PacketPair> pairs_;
+
+            void validate(PacketValidator* validator) override;
+            void report() override;
+    };
+
+    /**
+     * Message headers and receive buffers for batched sends and receives, allocated once and shared by all clients
+     */
+    class DatagramBuffers {
+        public:
+            // room for the UDP_SEGMENT or UDP_GRO control message of one message
+            static constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(int));
+
+            const int batch_size_;
+            const int recv_buf_size_;
+
+            std::unique_ptr<uint8_t[]> recv_buf_;
+            std::unique_ptr<char[]> control_;
+            std::vector<struct mmsghdr> msgs_;
+            std::vector<struct iovec> iovs_;
+
+            // source address of each received message
+            std::vector<struct sockaddr_storage> names_;
+
+            // the datagrams of the current receive batch, split from coalesced messages
+            std::vector<std::pair<uint8_t*, int>> datagrams_;
+
+            // the actions of the current send batch
+            std::vector<const Action*> send_actions_;
+
+            // the responses of the current receive batch with their expected responses, validated together
+            std::vector<PacketPair> pairs_;
+
+            explicit DatagramBuffers(const UdpReplayOptions& options) :
+                batch_size_(options.batch_size_), recv_buf_size_(options.recv_buf_size_),
+                recv_buf_(new uint8_t[static_cast<size_t>(options.batch_size_) * options.recv_buf_size_]),
+                control_(new char[options.batch_size_ * CONTROL_SIZE]()),
+                msgs_(options.batch_size_), iovs_(options.batch_size_), names_(options.batch_size_) {
+            }
+
+            uint8_t* recvBuffer(int idx) {
+                return recv_buf_.get() + static_cast<size_t>(idx) * recv_buf_size_;
+            }
+
+            char* control(int idx) {
+                return control_.get() + idx * CONTROL_SIZE;
+            }
+    };
+
+    /**
+     * A UDP client used to replay a conversation
      */
     class UdpReplayClient {
         private:
             UdpConversation* conversation_;
             int socket_;
             PacketValidator* validator_;
+            const UdpReplayOptions& options_;
+            DatagramBuffers& buffers_;
+
+            // datagrams coalesced with the last datagram of a receive batch, kept for the next batch
+            std::vector<uint8_t> spill_;
+            std::vector<int> spill_lens_;
+            size_t spill_pos_ = 0;
+            size_t spill_idx_ = 0;
+
+            size_t sent_ = 0;
+            size_t received_ = 0;
+
+            // received datagrams larger than the receive buffer, cut to its size
+            size_t truncated_ = 0;
+
+            // set when responses are validated asynchronously
+            std::unique_ptr<ValidationQueue> validation_queue_;
+
+            /**
+             * An expected response in windowed mode
+             */
+            class Outstanding {
+                public:
+                    std::unique_ptr<Action> expected_;
+                    std::chrono::steady_clock::time_point deadline_;
+
+                    // the key the response is matched by.  if rewritten, the request was sent with this key instead
+                    // of the captured key and the captured key is put back into the response before validation
+                    uint64_t key_;
+                    uint64_t captured_key_;
+                    bool rewritten_;
+
+                    // false if the response has no key, it is then matched with keyless_
+                    bool keyed_;
+            };
+
+            // expected responses in the order their requests were sent.  a null action has been matched.  the
+            // response at the front has sequence number outstanding_base_
+            std::deque<Outstanding> outstanding_;
+            uint64_t outstanding_base_ = 0;
+            size_t open_ = 0;
+
+            // key to the sequence numbers of the outstanding responses with that key, oldest first
+            std::unordered_map<uint64_t, std::deque<uint64_t>> outstanding_keys_;
+
+            // the sequence numbers of the outstanding responses without a key, matched in order.  kept apart so they
+            // never match a response whose key happens to be 0 or a rewritten key
+            std::deque<uint64_t> keyless_;
+
+            // the next key tried when a request key is rewritten
+            uint64_t next_key_ = 0;
+
+            // the expected responses of the matched responses waiting for validation
+            std::vector<std::unique_ptr<Action>> validated_;
+
+            size_t matched_ = 0;
+            size_t lost_ = 0;
+            size_t unexpected_ = 0;
 
             UdpReplayClient(const UdpReplayClient&) = delete;
             UdpReplayClient& operator=(const UdpReplayClient&) = delete;
             UdpReplayClient() = delete;
 
+            size_t countActions(Action::Type type, size_t max);
+            size_t gsoRunLength(size_t start, size_t count);
+            void sendBatch();
+            void recvBatch(size_t count);
+            void validatePairs();
+            int receiveMessages(size_t slot, size_t count, int flags);
+            bool fromServer(const struct sockaddr_storage& addr) const;
+            bool keyOf(const uint8_t* data, int data_len, uint64_t& key) const;
+            bool allocateKey(uint64_t& key);
+            void removeOutstanding(bool keyed, uint64_t key);
+            void matchResponse(uint8_t* data, int data_len);
+            void expireOutstanding();
+            void replayWindowed();
+
         public:
             /**
              * @param conversation the conversation to reply
-             * @param validator a pointer to the object that performs packet validation.  
-             *                  Ownership is transferred to this object and will be freed by this object.
+             * @param validator a pointer to the object that performs packet validation.  The validator is not owned
+             *                  by this object, so one validator can be used for all conversations.  Not used when
+             *                  the options have a validation pipeline.
+             * @param options the replay options
+             * @param buffers the buffers used for sending and receiving
              */
-            UdpReplayClient(UdpConversation* conversation, PacketValidator* validator);
+            UdpReplayClient(UdpConversation* conversation, PacketValidator* validator, const UdpReplayOptions& options, DatagramBuffers& buffers);
 
             ~UdpReplayClient() {
                 if (socket_ >= 0) {
                     close(socket_);
                 }
-                delete validator_;
             }
             
+            /**
+             * Replay the conversation.  In windowed mode requests are sent as long as fewer than the window size of
+             * responses are outstanding, and responses are matched to the expected responses by key in any order.
+             * If the key extractor can replace keys, each request is sent with a key no other outstanding request
+             * uses, so requests captured at different times with the same key can be outstanding together.
+             * Otherwise the actions are replayed in order.  Consecutive SEND actions are sent with one sendmmsg call and consecutive RECV
+             * actions are received with recvmmsg, up to the batch size per call.  With offload enabled, runs of equal
+             * sized datagrams are passed to the kernel as one message that is segmented on the way out, and coalesced
+             * received messages are split back into datagrams before validation.
+             */
             void replay();
+
+            size_t sent() const {
+                return sent_;
+            }
+
+            size_t received() const {
+                return received_;
+            }
+
+            size_t matched() const {
+                return matched_;
+            }
+
+            size_t lost() const {
+                return lost_;
+            }
+
+            size_t unexpected() const {
+                return unexpected_;
+            }
+
+            size_t truncated() const {
+                return truncated_;
+            }
     };
 }
 
-#endif
\ No newline at end of file
+#endif